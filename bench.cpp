@@ -0,0 +1,371 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <functional>
+#include <iterator>
+#include <numeric>
+#include <ranges>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "utils.h"
+
+/*
+bench [--quick] [--filter <substring>] [--json <path>]
+
+every case runs the utils.h implementation and the closest std:: / std::ranges
+equivalent on the same input, for int32/int64/float/double and working sets
+from L1-resident to beyond the last level cache. all results are written to a
+JSON file (bench_results.json by default) so runs can be diffed.
+*/
+
+struct bench_context {
+  utils::benchmark_options options;
+  std::string filter;
+  std::vector<utils::benchmark_result> results;
+};
+
+template <typename FU, typename FS>
+void compare(bench_context &ctx, const std::string &name, std::size_t bytes,
+             FU &&utils_impl, FS &&std_impl) {
+  if (name.find(ctx.filter) == std::string::npos) {
+    return;
+  }
+  auto options = ctx.options;
+  options.bytes_per_call = bytes;
+  auto u = utils::benchmark(name + "/utils", options, utils_impl);
+  auto s = utils::benchmark(name + "/std", options, std_impl);
+  char line[256];
+  std::snprintf(line, sizeof(line),
+                "%-32s utils %12.1f ns  std %12.1f ns  utils/std %5.2fx",
+                name.c_str(), u.median_ns, s.median_ns,
+                u.median_ns / s.median_ns);
+  utils::println(line);
+  ctx.results.push_back(std::move(u));
+  ctx.results.push_back(std::move(s));
+}
+
+std::string size_name(std::size_t bytes) {
+  return bytes >= (1 << 20) ? std::to_string(bytes >> 20) + "MiB"
+                            : std::to_string(bytes >> 10) + "KiB";
+}
+
+// the two std::accumulate passes utils::max/utils::min did before minmax
+template <typename T> T two_pass_minmax(const std::vector<T> &v) {
+  T mx = std::accumulate(v.begin(), v.end(), *v.begin(),
+                         [](auto a, auto b) { return a < b ? b : a; });
+  T mn = std::accumulate(v.begin(), v.end(), *v.begin(),
+                         [](auto a, auto b) { return a < b ? a : b; });
+  return mx - mn;
+}
+
+// the elements of v one at a time, as an unbounded source would produce them
+template <typename T> utils::generator<T> stream(const std::vector<T> &v) {
+  for (T x : v) {
+    co_yield x;
+  }
+}
+
+template <typename T>
+void bench_type(bench_context &ctx, const std::string &type_name,
+                std::size_t bytes) {
+  const std::size_t n = bytes / sizeof(T);
+  const std::string tag = "/" + type_name + "/" + size_name(bytes);
+  std::vector<T> a(n);
+  std::vector<T> b(n);
+  for (std::size_t i = 0; i < n; ++i) {
+    a[i] = static_cast<T>(i % 1000);
+    b[i] = static_cast<T>((i * 7) % 1000);
+  }
+  const std::vector<T> ones(n, T(1));
+  // distinct storage, so neither side can short-circuit on equal addresses
+  const std::vector<T> a_copy = a;
+  auto square = [](T x) { return x * x; };
+  auto pred = [](T x) { return x < T(500); };
+
+  compare(
+      ctx, "sum" + tag, bytes, [&] { return utils::sum(a); },
+      [&] { return std::accumulate(a.begin(), a.end(), T(0)); });
+  compare(
+      ctx, "prod" + tag, bytes, [&] { return utils::prod(ones); },
+      [&] {
+        return std::accumulate(ones.begin(), ones.end(), T(1),
+                               std::multiplies<T>());
+      });
+  compare(
+      ctx, "numel" + tag, bytes, [&] { return utils::numel(ones); },
+      [&] {
+        return std::accumulate(ones.begin(), ones.end(), T(1),
+                               std::multiplies<T>());
+      });
+  compare(
+      ctx, "map" + tag, bytes, [&] { return utils::map(square, a); },
+      [&] {
+        std::vector<T> out(a.size());
+        std::ranges::transform(a, out.begin(), square);
+        return out;
+      });
+  compare(
+      ctx, "select" + tag, bytes, [&] { return utils::select(a, pred); },
+      [&] {
+        std::vector<T> out;
+        std::ranges::copy_if(a, std::back_inserter(out), pred);
+        return out;
+      });
+  compare(
+      ctx, "slice" + tag, bytes / 4,
+      [&] {
+        return utils::slice(a, n / 4, 3 * n / 4, 2, std::allocator<T>());
+      },
+      [&] {
+        std::vector<T> out;
+        out.reserve(n / 4);
+        for (std::size_t i = n / 4; i < 3 * n / 4; i += 2) {
+          out.push_back(a[i]);
+        }
+        return out;
+      });
+  compare(
+      ctx, "slice_sum" + tag, bytes / 2,
+      [&] { return utils::sum(utils::slice(a, n / 4, 3 * n / 4, 2)); },
+      [&] {
+        T acc = T(0);
+        for (std::size_t i = n / 4; i < 3 * n / 4; i += 2) {
+          acc += a[i];
+        }
+        return acc;
+      });
+  compare(
+      ctx, "range" + tag, bytes,
+      [&] {
+        return utils::range(T(0), static_cast<T>(n), T(1), std::allocator<T>());
+      },
+      [&] {
+        std::vector<T> out(n);
+        std::iota(out.begin(), out.end(), T(0));
+        return out;
+      });
+  compare(
+      ctx, "range_sum" + tag, bytes,
+      [&] { return utils::sum(utils::range(T(0), static_cast<T>(n), T(1))); },
+      [&] {
+        auto values = std::views::iota(std::size_t(0), n) |
+                      std::views::transform(
+                          [](std::size_t i) { return static_cast<T>(i); });
+        return std::accumulate(values.begin(), values.end(), T(0));
+      });
+  compare(
+      ctx, "zip" + tag, 2 * bytes,
+      [&] {
+        T acc = T(0);
+        for (auto &&[x, y] : utils::zip(a, b)) {
+          acc += x * y;
+        }
+        return acc;
+      },
+      [&] { return std::inner_product(a.begin(), a.end(), b.begin(), T(0)); });
+  compare(
+      ctx, "enumerate" + tag, bytes,
+      [&] {
+        std::uint64_t acc = 0;
+        for (auto &&[i, x] : utils::enumerate(a)) {
+          acc += i * static_cast<std::uint64_t>(x);
+        }
+        return acc;
+      },
+      [&] {
+        std::uint64_t acc = 0;
+        for (std::size_t i = 0; i < a.size(); ++i) {
+          acc += i * static_cast<std::uint64_t>(a[i]);
+        }
+        return acc;
+      });
+  compare(
+      ctx, "max" + tag, bytes, [&] { return utils::max(a); },
+      [&] { return std::ranges::max(a); });
+  compare(
+      ctx, "min" + tag, bytes, [&] { return utils::min(a); },
+      [&] { return std::ranges::min(a); });
+  compare(
+      ctx, "minmax" + tag, bytes, [&] { return utils::minmax(a); },
+      [&] { return std::ranges::minmax(a); });
+  compare(
+      ctx, "two_pass_minmax" + tag, bytes,
+      [&] {
+        auto [mn, mx] = utils::minmax(a);
+        return mx - mn;
+      },
+      [&] { return two_pass_minmax(a); });
+  compare(
+      ctx, "argmax" + tag, bytes, [&] { return utils::argmax(a); },
+      [&] { return std::ranges::max_element(a) - a.begin(); });
+  compare(
+      ctx, "argmin" + tag, bytes, [&] { return utils::argmin(a); },
+      [&] { return std::ranges::min_element(a) - a.begin(); });
+  compare(
+      ctx, "fold" + tag, bytes, [&] { return utils::fold(std::plus<T>(), a); },
+      [&] { return std::accumulate(a.begin(), a.end(), T(0)); });
+  compare(
+      ctx, "fold_assoc" + tag, bytes,
+      [&] { return utils::fold_assoc(std::plus<T>(), a); },
+      [&] { return std::accumulate(a.begin(), a.end(), T(0)); });
+  std::vector<T> scanned(n);
+  compare(
+      ctx, "accumulate_list" + tag, 2 * bytes,
+      [&] {
+        utils::accumulate_list_into(a, scanned);
+        return scanned.back();
+      },
+      [&] {
+        std::inclusive_scan(a.begin(), a.end(), scanned.begin());
+        return scanned.back();
+      });
+  compare(
+      ctx, "generator" + tag, bytes,
+      [&] { return utils::sum(utils::map(square, stream(a))); },
+      [&] {
+        T acc = T(0);
+        for (T x : a) {
+          acc += square(x);
+        }
+        return acc;
+      });
+  compare(
+      ctx, "dot" + tag, 2 * bytes, [&] { return utils::dot(a, b); },
+      [&] { return std::inner_product(a.begin(), a.end(), b.begin(), T(0)); });
+  compare(
+      ctx, "equals" + tag, 2 * bytes,
+      [&] { return utils::equals(a, a_copy); },
+      [&] { return std::ranges::equal(a, a_copy); });
+  // text output is ~100x slower than the rest, keep it to the small sizes
+  if (bytes <= (std::size_t(256) << 10)) {
+    std::string out;
+    compare(
+        ctx, "print" + tag, bytes,
+        [&] {
+          out.clear();
+          utils::print_to(out, a);
+          return out.size();
+        },
+        [&] {
+          std::ostringstream os;
+          std::ranges::copy(a, std::ostream_iterator<T>(os, ", "));
+          return os.str().size();
+        });
+  }
+}
+
+// n x n matrix products against the textbook i-k-j loop, and the outer
+// product of two n vectors
+template <typename T>
+void bench_matrix(bench_context &ctx, const std::string &type_name,
+                  std::size_t n) {
+  const std::string tag = "/" + type_name + "/" + std::to_string(n);
+  utils::tensor<T, 2> a(n, n);
+  utils::tensor<T, 2> b(n, n);
+  for (std::size_t i = 0; i < a.size(); ++i) {
+    a.data()[i] = static_cast<T>(i % 13);
+    b.data()[i] = static_cast<T>((i * 7) % 11);
+  }
+  const std::size_t bytes = 3 * n * n * sizeof(T);
+  compare(
+      ctx, "matmul" + tag, bytes, [&] { return utils::dot(a, b); },
+      [&] {
+        utils::tensor<T, 2> c(n, n);
+        for (std::size_t i = 0; i < n; ++i) {
+          for (std::size_t p = 0; p < n; ++p) {
+            T x = a(i, p);
+            const T *row = b.data() + p * n;
+            T *out = c.data() + i * n;
+            for (std::size_t j = 0; j < n; ++j) {
+              out[j] += x * row[j];
+            }
+          }
+        }
+        return c;
+      });
+  std::vector<T> x(a.data(), a.data() + n);
+  std::vector<T> y(b.data(), b.data() + n);
+  compare(
+      ctx, "outer" + tag, n * n * sizeof(T),
+      [&] { return utils::outer(std::multiplies<>{}, x, y); },
+      [&] {
+        std::vector<std::vector<T>> out(n, std::vector<T>(n));
+        for (std::size_t i = 0; i < n; ++i) {
+          std::ranges::transform(y, out[i].begin(),
+                                 [&](T v) { return x[i] * v; });
+        }
+        return out;
+      });
+}
+
+// an expensive pure function over n inputs drawn from 1000 distinct keys,
+// memoized against evaluating it every time
+void bench_memoize(bench_context &ctx, std::size_t n) {
+  const std::string tag = "/" + std::to_string(n);
+  std::vector<int> keys(n);
+  for (std::size_t i = 0; i < n; ++i) {
+    keys[i] = static_cast<int>((i * 7919) % 1000);
+  }
+  auto expensive = [](int x) {
+    double acc = x;
+    for (int i = 0; i < 200; ++i) {
+      acc = std::sqrt(acc + i);
+    }
+    return acc;
+  };
+  auto cached = utils::memoize(expensive);
+  compare(
+      ctx, "memoize" + tag, n * sizeof(int),
+      [&] { return utils::map(utils::par, cached, keys); },
+      [&] { return utils::map(utils::par, expensive, keys); });
+}
+
+int main(int argc, char **argv) {
+  bench_context ctx;
+  ctx.options.samples = 10;
+  ctx.options.min_sample_time = std::chrono::milliseconds(1);
+  std::string json_path = "bench_results.json";
+  // L1, L2, LLC and main memory resident working sets
+  std::vector<std::size_t> sizes{std::size_t(16) << 10, std::size_t(256) << 10,
+                                 std::size_t(8) << 20, std::size_t(64) << 20};
+  for (int i = 1; i < argc; ++i) {
+    std::string arg = argv[i];
+    if (arg == "--quick") {
+      sizes.resize(2);
+    } else if (arg == "--filter" && i + 1 < argc) {
+      ctx.filter = argv[++i];
+    } else if (arg == "--json" && i + 1 < argc) {
+      json_path = argv[++i];
+    } else {
+      utils::println_to(stderr, "usage:", argv[0],
+                        "[--quick] [--filter <substring>] [--json <path>]");
+      return 1;
+    }
+  }
+
+  for (auto bytes : sizes) {
+    bench_type<int32_t>(ctx, "int32", bytes);
+    bench_type<int64_t>(ctx, "int64", bytes);
+    bench_type<float>(ctx, "float", bytes);
+    bench_type<double>(ctx, "double", bytes);
+  }
+  std::vector<std::size_t> orders{64, 256, 1024};
+  orders.resize(sizes.size() == 2 ? 2 : 3);
+  for (auto n : orders) {
+    bench_matrix<int32_t>(ctx, "int32", n);
+    bench_matrix<float>(ctx, "float", n);
+    bench_matrix<double>(ctx, "double", n);
+  }
+  bench_memoize(ctx, std::size_t(1) << 16);
+  if (sizes.size() > 2) {
+    bench_memoize(ctx, std::size_t(1) << 22);
+  }
+
+  std::ofstream(json_path) << utils::to_json(ctx.results);
+  utils::println("wrote", ctx.results.size(), "results to", json_path);
+  return 0;
+}
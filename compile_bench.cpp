@@ -0,0 +1,36 @@
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+
+#ifdef UTILS_IMPORT
+import utils;
+#else
+#include "utils.h"
+#endif
+
+/*
+a typical translation unit using utils.h, compiled by compile_time.cmake with
+utils.h included, with the common instantiations taken from the utils library
+and with `import utils;` to compare their compile times.
+*/
+
+template <typename T> T reductions(const std::vector<T> &v) {
+  return utils::sum(v) + utils::prod(v) + utils::max(v) - utils::min(v);
+}
+
+int main() {
+  std::vector<int> i32(100, 1);
+  std::vector<std::int64_t> i64(100, 2);
+  std::vector<float> f32(100, 0.5f);
+  std::vector<double> f64(100, 0.25);
+  auto squares = utils::map([](int x) { return x * x; }, i32);
+  auto evens = utils::select(squares, [](int x) { return x % 2 == 0; });
+  auto odd_squares = i32 | utils::views::slice(1, std::nullopt, 2) |
+                     utils::views::map([](int x) { return x * x; });
+  utils::println(reductions(i32), reductions(i64), reductions(f32),
+                 reductions(f64), utils::sum(evens), utils::sum(odd_squares));
+  utils::println(utils::fold([](int a, int b) { return a + b; }, i32),
+                 utils::nest([](double x) { return x / 2; }, 1.0, 3));
+  return 0;
+}
@@ -0,0 +1,56 @@
+# compile time of compile_bench.cpp with utils.h included, with the common
+# instantiations from the utils library and with import utils. where the
+# toolchain has no module support the last variant is the precompiled utils.h
+# and is reported as "pch":
+#   cmake -S . -B build && cmake -DBUILD_DIR=build -P compile_time.cmake
+cmake_minimum_required(VERSION 3.23)
+
+if(NOT BUILD_DIR)
+  message(FATAL_ERROR "usage: cmake -DBUILD_DIR=<build dir> -P compile_time.cmake")
+endif()
+if(NOT RUNS)
+  set(RUNS 5)
+endif()
+
+file(STRINGS ${BUILD_DIR}/CMakeCache.txt has_module
+     REGEX "^UTILS_HAS_MODULE:INTERNAL=ON$")
+if(has_module)
+  set(last module)
+else()
+  set(last pch)
+  message("no C++20 module support (see UTILS_MODULE in CMakeLists.txt), "
+          "timing the precompiled utils.h instead")
+endif()
+set(variants header precompiled ${last})
+foreach(variant ${variants})
+  # the library, module interface or precompiled header are built here, only
+  # the translation unit itself is rebuilt while timing
+  execute_process(COMMAND ${CMAKE_COMMAND} --build ${BUILD_DIR} --target
+                          compile_bench_${variant}
+                  OUTPUT_QUIET RESULT_VARIABLE failed)
+  if(failed)
+    message(FATAL_ERROR "building compile_bench_${variant} failed")
+  endif()
+endforeach()
+
+foreach(variant ${variants})
+  set(best "")
+  foreach(run RANGE 1 ${RUNS})
+    file(TOUCH ${BUILD_DIR}/compile_bench_${variant}.cpp)
+    string(TIMESTAMP start "%s%f")
+    execute_process(COMMAND ${CMAKE_COMMAND} --build ${BUILD_DIR} --target
+                            compile_bench_${variant}
+                    OUTPUT_QUIET)
+    string(TIMESTAMP stop "%s%f")
+    math(EXPR ms "(${stop} - ${start}) / 1000")
+    if(best STREQUAL "" OR ms LESS best)
+      set(best ${ms})
+    endif()
+  endforeach()
+  set(${variant}_ms ${best})
+  message("${variant}: ${best} ms")
+endforeach()
+
+math(EXPR precompiled_pct "100 * ${precompiled_ms} / ${header_ms}")
+math(EXPR last_pct "100 * ${${last}_ms} / ${header_ms}")
+message("precompiled/header ${precompiled_pct}%, ${last}/header ${last_pct}%")
@@ -1,7 +1,15 @@
+#include <algorithm>
+#include <array>
 #include <cmath>
 #include <gtest/gtest.h>
 #include <iostream>
+#include <list>
+#include <memory>
+#include <memory_resource>
 #include <numeric>
+#include <sstream>
+#include <span>
+#include <thread>
 #include <ranges>
 #include <vector>
 
@@ -36,6 +44,40 @@ TEST(test, test_print) {
                  std::vector<std::vector<int>>{{1, 2, 3, 4, 5}}, 's');
 }
 
+TEST(test, print_to) {
+  std::string out;
+  utils::print_to(out, 1, 2.5, "abc", 'x', std::vector<int>{1, 2, 3});
+  EXPECT_EQ(out, "1 2.5 abc x [1, 2, 3]");
+
+  out.clear();
+  std::vector<std::vector<int>> nested{{1, 2}, {}, {3}};
+  utils::println_to(out, "v=", nested, std::vector<std::string>{"a", "b"});
+  EXPECT_EQ(out, "v= [[1, 2], [], [3]] [a, b]\n");
+
+  out.clear();
+  utils::print_to(out, 0.1, 1e300, -0.0f, 100000000);
+  EXPECT_EQ(out, "0.1 1e+300 -0 100000000");
+
+  std::vector<int> big(1000);
+  std::iota(big.begin(), big.end(), 0);
+  out.clear();
+  utils::print_to(out, utils::summary(big, 3));
+  EXPECT_EQ(out, "[0, 1, 2, ..., 997, 998, 999]");
+  out.clear();
+  utils::print_to(out, utils::summary(std::vector<int>{1, 2, 3}, 2));
+  EXPECT_EQ(out, "[1, 2, 3]");
+
+  std::ostringstream os;
+  utils::println_to(os, big.size(), utils::summary(big, 1));
+  EXPECT_EQ(os.str(), "1000 [0, ..., 999]\n");
+
+  // larger than the flush threshold, written in several batches
+  out.clear();
+  utils::print_to(out, big, big, big, big, big, big, big, big, big, big, big,
+                  big, big, big);
+  EXPECT_TRUE(out.size() > (1 << 16) && out.back() == ']');
+}
+
 TEST(test, sum) {
   std::vector<int> v1{1, 2, 3};
   std::vector<std::vector<int>> v2{{1, 2, 3}, {1, 2, 3}, {1, 2, 3}, {1, 2, 3}};
@@ -43,6 +85,30 @@ TEST(test, sum) {
   EXPECT_TRUE(utils::sum(v2) == 4 * (1 + 2 + 3));
 }
 
+TEST(test, sum_simd) {
+  // lengths around the vector block size exercise the scalar tail
+  for (int n : {0, 1, 15, 63, 64, 65, 1000, 4099}) {
+    std::vector<int64_t> vi(n);
+    std::vector<double> vd(n);
+    std::iota(vi.begin(), vi.end(), 1);
+    std::iota(vd.begin(), vd.end(), 1.0);
+    EXPECT_TRUE(utils::sum(vi) == int64_t(n) * (n + 1) / 2);
+    EXPECT_TRUE(utils::sum(vd) == double(n) * (n + 1) / 2);
+    EXPECT_TRUE(utils::sum(utils::kahan, vd) == double(n) * (n + 1) / 2);
+    EXPECT_TRUE(utils::sum(utils::pairwise, vd) == double(n) * (n + 1) / 2);
+  }
+  std::list<float> l{1.5f, 2.5f, 3.0f};
+  EXPECT_TRUE(utils::sum(l) == 7.0f && utils::sum(utils::kahan, l) == 7.0f);
+
+  // 1 + 1e-8 * 1e6 can not be represented by a naive float accumulator
+  std::vector<float> vf(1000001, 1e-8f);
+  vf[0] = 1.0f;
+  EXPECT_NEAR(utils::sum(utils::kahan, vf), 1.01f, 1e-6);
+  EXPECT_NEAR(utils::sum(utils::pairwise, vf), 1.01f, 1e-5);
+  std::vector<std::vector<float>> nested{vf, vf};
+  EXPECT_NEAR(utils::sum(utils::kahan, nested), 2.02f, 1e-6);
+}
+
 TEST(test, prod) {
   std::vector<int> v1{1, 2, 3};
   std::vector<std::vector<int>> v2{{1, 2, 3}, {1, 2, 3}, {1, 2, 3}, {1, 2, 3}};
@@ -81,12 +147,260 @@ TEST(test, map) {
   }
 }
 
+TEST(test, lazy_views) {
+  std::vector<int> v1{1, 2, 3, 4, 5, 6, 7, 8, 9, 10};
+  int calls = 0;
+  auto pipeline = v1 | utils::views::select([](int x) { return x % 2 == 0; }) |
+                  utils::views::map([&calls](int x) {
+                    calls++;
+                    return x * x;
+                  });
+  EXPECT_TRUE(calls == 0); // nothing evaluated yet
+  EXPECT_TRUE(utils::sum(pipeline) == 4 + 16 + 36 + 64 + 100);
+  EXPECT_TRUE(calls == 5);
+  EXPECT_TRUE(utils::prod(utils::views::select(
+                  v1, [](int x) { return x > 100; })) == 0);
+
+  auto s = v1 | utils::views::slice(1, 100, 3);
+  static_assert(std::ranges::random_access_range<decltype(s)>);
+  EXPECT_TRUE(s.size() == 3 && s[0] == 2 && s[1] == 5 && s[2] == 8);
+  for (auto &x : s) {
+    x = 0; // slices refer to the original storage
+  }
+  EXPECT_TRUE(v1[1] == 0 && v1[4] == 0 && v1[7] == 0 && v1[2] == 3);
+  EXPECT_THROW(utils::views::slice(v1, 0, 5, 0), std::runtime_error);
+
+  auto r = utils::views::range(0.0, 1.0, 0.25);
+  EXPECT_TRUE(utils::equals(r | utils::to_vector(),
+                            std::vector<double>{0.0, 0.25, 0.5, 0.75}));
+  EXPECT_TRUE(utils::equals(
+      utils::to_vector(utils::views::map([](int x) { return x + 1; },
+                                         utils::views::range(0, 9, 3))),
+      utils::map([](int x) { return x + 1; }, utils::range(0, 9, 3))));
+}
+
+// counts the allocations made through it and its rebound copies
+template <typename T> struct counting_allocator {
+  using value_type = T;
+  std::size_t *count;
+  explicit counting_allocator(std::size_t *c) : count(c) {}
+  template <typename U>
+  counting_allocator(const counting_allocator<U> &other)
+      : count(other.count) {}
+  T *allocate(std::size_t n) {
+    ++*count;
+    return std::allocator<T>().allocate(n);
+  }
+  void deallocate(T *p, std::size_t n) { std::allocator<T>().deallocate(p, n); }
+  template <typename U>
+  bool operator==(const counting_allocator<U> &other) const {
+    return count == other.count;
+  }
+};
+
+TEST(test, allocator) {
+  std::vector<int> v(1000);
+  std::iota(v.begin(), v.end(), 0);
+  auto is_even = [](int x) { return x % 2 == 0; };
+  auto half = [](int x) { return x / 2.0; };
+
+  std::size_t count = 0;
+  counting_allocator<char> counting(&count);
+  auto evens = utils::select(v, is_even, counting);
+  static_assert(
+      std::is_same_v<decltype(evens),
+                     std::vector<int, counting_allocator<int>>>);
+  EXPECT_EQ(evens.size(), 500);
+  EXPECT_EQ(utils::map(half, v, counting).back(), 499.5);
+  EXPECT_EQ(utils::range(0, 10, 3, counting).size(), 4);
+  EXPECT_EQ(utils::slice(v, 10, 20, 2, counting).front(), 10);
+  EXPECT_EQ(utils::to_vector(v | utils::views::map(half), counting)[3], 1.5);
+  EXPECT_EQ(utils::fold_list(std::plus<>{}, 0, v, counting).back(), 499500);
+  EXPECT_EQ(count, 6); // exactly one allocation per result
+
+  auto &arena = utils::thread_arena();
+  std::size_t before = arena.bytes_used();
+  {
+    utils::arena_scope request;
+    auto mapped = utils::map(half, v, request.resource());
+    static_assert(std::is_same_v<decltype(mapped), std::pmr::vector<double>>);
+    auto selected = utils::select(v, is_even, request.resource());
+    auto sliced = utils::slice(v, 0, 1000, 10, request.resource());
+    auto offsets = utils::fold_list(std::plus<>{}, 0, sliced, request.resource());
+    static_assert(std::is_same_v<decltype(offsets), std::pmr::vector<int>>);
+    EXPECT_EQ(offsets.back(), utils::sum(sliced));
+    EXPECT_TRUE(utils::equals(mapped, utils::map(half, v)));
+    EXPECT_TRUE(utils::equals(selected, utils::select(v, is_even)));
+    EXPECT_TRUE(utils::equals(sliced, utils::slice(v, 0, 1000, 10)));
+    EXPECT_GE(arena.bytes_used(),
+              before + 1000 * sizeof(double) + 1000 * sizeof(int));
+    {
+      utils::arena_scope nested;
+      auto r = utils::range(0.0, 1.0, 0.25, nested.resource());
+      EXPECT_EQ(r.size(), 4);
+    }
+    EXPECT_EQ(sliced.back(), 990);
+  }
+  EXPECT_EQ(arena.bytes_used(), before);
+
+  // rewinding keeps the blocks, the next request reuses them
+  utils::bump_arena small(256);
+  auto first = utils::range(0, 100, 1, &small);
+  std::size_t capacity = small.capacity();
+  small.reset();
+  for (int i = 0; i < 10; ++i) {
+    auto again = utils::range(0, 100, 1, &small);
+    EXPECT_EQ(again[99], 99);
+    small.reset();
+  }
+  EXPECT_EQ(small.capacity(), capacity);
+  EXPECT_THROW(utils::slice(v, 0, 10, 0, &small), std::runtime_error);
+}
+
+TEST(test, file_sources) {
+  std::vector<float> values(100000);
+  for (std::size_t i = 0; i < values.size(); ++i) {
+    values[i] = static_cast<float>((i * 37) % 1001) - 500.0f;
+  }
+  std::string path = ::testing::TempDir() + "utils_file_sources.bin";
+  {
+    std::FILE *file = std::fopen(path.c_str(), "wb");
+    ASSERT_NE(file, nullptr);
+    std::fwrite(values.data(), sizeof(float), values.size(), file);
+    std::fputc(0, file); // a trailing partial value is ignored
+    std::fclose(file);
+  }
+
+  utils::mapped_array<float> mapped(path);
+  static_assert(std::ranges::contiguous_range<decltype(mapped)>);
+  static_assert(utils::ContainerWithArithmeticElement<decltype(mapped)>);
+  EXPECT_EQ(mapped.size(), values.size());
+  EXPECT_EQ(utils::sum(mapped), utils::sum(values));
+  EXPECT_EQ(utils::minmax(mapped), utils::minmax(values));
+  EXPECT_EQ(utils::select(mapped, [](float x) { return x > 490.0f; }),
+            utils::select(values, [](float x) { return x > 490.0f; }));
+  EXPECT_EQ(utils::sum(utils::mapped_array<float>(path)), utils::sum(values));
+  mapped.advise(utils::access_pattern::random);
+  EXPECT_EQ(mapped[12345], values[12345]);
+
+  // small chunks so a pass needs many refills and ends on a partial chunk
+  utils::streamed_array<float> streamed(path, 4096 + 12);
+  static_assert(std::ranges::input_range<decltype(streamed)>);
+  static_assert(utils::ContainerWithArithmeticElement<decltype(streamed)>);
+  EXPECT_EQ(utils::sum(streamed), utils::sum(values));
+  EXPECT_EQ(utils::max(streamed), utils::max(values));
+  EXPECT_EQ(utils::min(streamed), utils::min(values));
+  std::size_t chunks = 0;
+  streamed.for_each_chunk([&](std::span<const float> chunk) {
+    EXPECT_LE(chunk.size(), 1027);
+    ++chunks;
+  });
+  EXPECT_EQ(chunks, (values.size() + 1026) / 1027);
+  std::size_t count = 0;
+  bool same = true;
+  for (float x : streamed) {
+    same = same && x == values[count++];
+  }
+  EXPECT_TRUE(same);
+  EXPECT_EQ(count, values.size());
+  EXPECT_EQ(utils::to_vector(streamed), values);
+  auto moved = std::move(streamed);
+  EXPECT_EQ(utils::sum(moved), utils::sum(values));
+  EXPECT_THROW(utils::sum(streamed), std::runtime_error);
+
+#if !defined(_WIN32)
+  // a FIFO can not seek: the first pass works, a second one throws
+  std::string fifo = ::testing::TempDir() + "utils_file_sources.fifo";
+  std::remove(fifo.c_str());
+  ASSERT_EQ(mkfifo(fifo.c_str(), 0600), 0);
+  std::thread writer([&] {
+    std::FILE *file = std::fopen(fifo.c_str(), "wb");
+    std::fwrite(values.data(), sizeof(float), values.size(), file);
+    std::fclose(file);
+  });
+  utils::streamed_array<float> piped(fifo, 4096);
+  EXPECT_EQ(utils::sum(piped), utils::sum(values));
+  writer.join();
+  EXPECT_THROW(utils::sum(piped), std::runtime_error);
+  std::remove(fifo.c_str());
+#endif
+
+  std::remove(path.c_str());
+  EXPECT_THROW(utils::mapped_array<float>{path}, std::runtime_error);
+  EXPECT_THROW(utils::streamed_array<float>{path}, std::runtime_error);
+}
+
 TEST(test, shape_to_string) {
   std::vector<int> v1{1, 2, 3, -1, -2, -3};
   std::vector<std::vector<int>> v2{{1, 2, 3}, {1, 2, 3}, {1, 2, 3}, {1, 2, 3}};
   utils::println(utils::shape_to_string(v1), utils::shape_to_string(v2));
 }
 
+TEST(test, tensor) {
+  std::vector<std::vector<int>> nested{{1, 2, 3}, {4, 5, 6}};
+  auto m = utils::to_tensor(nested);
+  static_assert(std::is_same_v<decltype(m), utils::tensor<int, 2>>);
+  static_assert(std::ranges::contiguous_range<decltype(m)>);
+  static_assert(std::ranges::forward_range<utils::tensor_view<int, 3>>);
+  static_assert(std::ranges::view<utils::tensor_view<const int, 2>>);
+  EXPECT_EQ(reinterpret_cast<std::uintptr_t>(m.data()) % 64, 0);
+  EXPECT_EQ(m.to_nested(), nested);
+  EXPECT_EQ(m(1, 2), 6);
+  EXPECT_EQ(utils::shape_to_string(m), "[2,3]");
+  EXPECT_EQ(utils::numel(m), 6);
+  EXPECT_EQ(utils::sum(m), 21);
+  EXPECT_EQ(utils::prod(m), 720);
+
+  // views share the buffer
+  auto t = m.transpose();
+  EXPECT_EQ(utils::shape_to_string(t), "[3,2]");
+  EXPECT_FALSE(t.is_contiguous());
+  EXPECT_EQ(t.to_nested(),
+            (std::vector<std::vector<int>>{{1, 4}, {2, 5}, {3, 6}}));
+  t(0, 1) = 40;
+  EXPECT_EQ(m(1, 0), 40);
+  EXPECT_EQ(utils::sum(t), 57);
+  auto column = m.slice(1, 0, 3, 2);
+  EXPECT_EQ(column.to_nested(), (std::vector<std::vector<int>>{{1, 3}, {40, 6}}));
+  EXPECT_EQ(utils::prod(column[1]), 240);
+  EXPECT_EQ(utils::sum(m.slice(0, 1, 1)), 0);
+  EXPECT_THROW(m.slice(2, 0, 1), std::runtime_error);
+  EXPECT_THROW(t.reshape(std::array<std::size_t, 1>{6}), std::runtime_error);
+  EXPECT_EQ(utils::max(t), 40);
+
+  // row reductions and element-wise map keep the shape
+  auto row_sums =
+      utils::map([](auto row) { return utils::sum(row); }, m.rows());
+  EXPECT_EQ(row_sums, (std::vector<int>{6, 51}));
+  auto squared = utils::map([](int x) { return x * x; }, t);
+  EXPECT_EQ(squared.shape(), (std::array<std::size_t, 2>{3, 2}));
+  EXPECT_EQ(squared(2, 1), 36);
+  EXPECT_EQ(utils::tensor(t).to_nested(), t.to_nested());
+
+  // 3-d, strided along every axis
+  utils::tensor<double, 3> cube(4, 5, 6);
+  std::iota(cube.begin(), cube.end(), 0.0);
+  auto sub = cube.slice(0, 1, 4, 2).slice(2, 1, 6, 3).permute({2, 0, 1});
+  double expected = 0;
+  for (std::size_t i = 1; i < 4; i += 2) {
+    for (std::size_t j = 0; j < 5; ++j) {
+      for (std::size_t k = 1; k < 6; k += 3) {
+        expected += cube(i, j, k);
+      }
+    }
+  }
+  EXPECT_EQ(sub.shape(), (std::array<std::size_t, 3>{2, 2, 5}));
+  EXPECT_DOUBLE_EQ(utils::sum(sub), expected);
+  EXPECT_DOUBLE_EQ(utils::sum(cube.reshape(std::array<std::size_t, 1>{120})),
+                   119.0 * 120 / 2);
+
+  std::string out;
+  utils::print_to(out, m);
+  EXPECT_EQ(out, "[[1, 2, 3], [40, 5, 6]]");
+  EXPECT_THROW(utils::to_tensor(std::vector<std::vector<int>>{{1, 2}, {3}}),
+               std::runtime_error);
+}
+
 TEST(test, zip1) {
   std::vector<int> v1{1, 2, 3, -1, -2, -3};
   std::vector<int> v2{2, 3, 4, 5, 6, 7};
@@ -121,6 +435,45 @@ TEST(test, zip3) {
   }
 }
 
+TEST(test, zip4) {
+  std::vector<int> v1{1, 2, 3, 4};
+  std::vector<double> v2{0.5, 1.5, 2.5};
+  std::vector<int> v3{7, 8, 9, 10, 11};
+  auto z = utils::zip(v1, v2, v3);
+  static_assert(std::ranges::view<decltype(z)>);
+  static_assert(std::ranges::random_access_range<decltype(z)>);
+  EXPECT_TRUE(z.size() == 3 && std::ranges::distance(z) == 3);
+  for (auto &&[x, y, w] : z) {
+    x *= 10; // yields references, writes go to v1
+    w = 0;
+  }
+  EXPECT_TRUE(v1[0] == 10 && v1[2] == 30 && v1[3] == 4);
+  EXPECT_TRUE(v3[2] == 0 && v3[3] == 10);
+
+  int index = 0;
+  for (const auto &[x, y] : utils::zip(std::vector<int>{1, 2}, v2)) {
+    EXPECT_TRUE(x == index + 1 && y == v2[index]);
+    index++;
+  }
+  EXPECT_TRUE(index == 2);
+}
+
+TEST(test, zip5) {
+  // forward-only inputs of different lengths end in a sentinel
+  std::list<int> l1{1, 2, 3, 4};
+  std::list<std::string> l2{"a", "b", "c"};
+  auto z = utils::zip(l1, l2);
+  static_assert(!std::ranges::common_range<decltype(z)>);
+  std::vector<std::string> seen;
+  for (auto &&[x, s] : z) {
+    x = -x;
+    seen.push_back(s + std::to_string(x));
+  }
+  EXPECT_TRUE(seen == std::vector<std::string>({"a-1", "b-2", "c-3"}));
+  EXPECT_TRUE(l1 == std::list<int>({-1, -2, -3, 4}));
+  EXPECT_EQ(std::ranges::distance(utils::zip(l2, l1)), 3);
+}
+
 TEST(test, enumerate1) {
   std::vector<int> v1{1, 2, 3, 4, 5, 6, 7};
   int index = 0;
@@ -145,6 +498,52 @@ TEST(test, enumerate2) {
   }
 }
 
+TEST(test, enumerate3) {
+  // lvalues are borrowed: elements are references, nothing is copied
+  std::vector<std::vector<int>> v1{{1, 2, 3}, {4, 5}, {6}};
+  auto e = utils::enumerate(v1);
+  static_assert(std::ranges::random_access_range<decltype(e)>);
+  static_assert(std::ranges::view<decltype(e)>);
+  EXPECT_EQ(e.size(), 3);
+  for (auto &&[idx, val] : e) {
+    EXPECT_EQ(&val, &v1[idx]);
+    val.push_back(0);
+  }
+  EXPECT_EQ(v1[2], (std::vector<int>{6, 0}));
+
+  // start and step only change the reported index
+  std::vector<int> v2{10, 20, 30, 40};
+  std::vector<uint64_t> indices;
+  for (auto &&[idx, val] : utils::enumerate(v2, 5, 10)) {
+    EXPECT_EQ(val, v2[(idx - 5) / 10]);
+    indices.push_back(idx);
+  }
+  EXPECT_EQ(indices, (std::vector<uint64_t>{5, 15, 25, 35}));
+  auto [last_idx, last_val] = *std::ranges::prev(utils::enumerate(v2, 1).end());
+  EXPECT_EQ(last_idx, 4);
+  EXPECT_EQ(last_val, 40);
+  EXPECT_EQ(std::get<0>(utils::enumerate(v2, 0, 2)[3]), 6);
+
+  // rvalues are owned by the view
+  auto owned = utils::enumerate(std::vector<int>{7, 8, 9});
+  int total = 0;
+  for (auto &&[idx, val] : owned) {
+    total += static_cast<int>(idx) * val;
+  }
+  EXPECT_EQ(total, 8 + 18);
+
+  // composes with the lazy views, including forward-only ones
+  auto evens = v2 | utils::views::select([](int x) { return x % 20 == 0; }) |
+               utils::views::enumerate(1);
+  auto pairs = utils::to_vector(evens);
+  EXPECT_EQ(pairs, (std::vector<std::tuple<uint64_t, int>>{{1, 20}, {2, 40}}));
+  EXPECT_EQ(utils::sum(utils::enumerate(v2) |
+                       utils::views::map([](auto &&p) {
+                         return std::get<0>(p) * std::get<1>(p);
+                       })),
+            20 + 60 + 120);
+}
+
 TEST(test, zip_enumerate1) {
   std::vector<int> v1{1, 2, 3};
   std::vector<int> v2{2, 3, 4, 5, 6, 7, 9, 9, 9, 9, 9, 9, 9, 9};
@@ -203,6 +602,39 @@ TEST(test, max_min) {
   EXPECT_TRUE(utils::max(v2) == utils::min(v2) && utils::max(v2) == 3);
 }
 
+TEST(test, minmax) {
+  std::vector<int> v1{3, 4, 5, 6, 7, 99, -100, 99, -100};
+  EXPECT_TRUE(utils::minmax(v1) == std::make_pair(-100, 99));
+  EXPECT_TRUE(utils::argmax(v1) == 5 && utils::argmin(v1) == 6);
+
+  std::array<double, 3> a{1.5, -2.5, 0.5};
+  EXPECT_TRUE(utils::max(a) == 1.5 && utils::min(a) == -2.5);
+  std::vector<float> big(10000);
+  std::iota(big.begin(), big.end(), -5000.0f);
+  big[7777] = 1e9f;
+  std::span<const float> raw(big.data(), big.size());
+  EXPECT_TRUE(utils::minmax(raw) == std::make_pair(-5000.0f, 1e9f));
+  EXPECT_TRUE(utils::argmax(raw) == 7777 && utils::argmin(raw) == 0);
+
+  const double nan = std::numeric_limits<double>::quiet_NaN();
+  std::vector<double> vn(100, 1.0);
+  vn[10] = nan;
+  vn[50] = 5.0;
+  vn[70] = nan;
+  EXPECT_TRUE(std::isnan(utils::minmax(vn).first));
+  EXPECT_TRUE(utils::argmax(vn) == 10);
+  EXPECT_TRUE(utils::minmax(vn, utils::nan_policy::ignore) ==
+              std::make_pair(1.0, 5.0));
+  EXPECT_TRUE(utils::argmax(vn, utils::nan_policy::ignore) == 50);
+  std::list<double> ln(vn.begin(), vn.end());
+  EXPECT_TRUE(utils::argmin(ln) == 10 &&
+              utils::argmax(ln, utils::nan_policy::ignore) == 50);
+  std::vector<double> all_nan(5, nan);
+  EXPECT_THROW(utils::argmax(all_nan, utils::nan_policy::ignore),
+               std::runtime_error);
+  EXPECT_THROW(utils::minmax(std::vector<int>{}), std::runtime_error);
+}
+
 TEST(test, select) {
   std::vector<int> v1{3, 4, 5, 6, 7, 99, -100};
   auto val1 = utils::select(v1, [](auto v) { return v % 2 == 0; });
@@ -211,6 +643,77 @@ TEST(test, select) {
               val1[2] == -100);
 }
 
+template <typename T> void check_select_simd() {
+  for (int n : {0, 1, 7, 8, 16, 33, 1000, 4097}) {
+    std::vector<T> v(n);
+    std::iota(v.begin(), v.end(), T(0));
+    auto pred = [](T x) { return static_cast<int64_t>(x) % 3 != 1; };
+    std::vector<T> expected;
+    std::copy_if(v.begin(), v.end(), std::back_inserter(expected), pred);
+    EXPECT_TRUE(utils::select(v, pred) == expected);
+  }
+}
+
+TEST(test, select_simd) {
+  check_select_simd<int8_t>();
+  check_select_simd<int32_t>();
+  check_select_simd<uint64_t>();
+  check_select_simd<float>();
+  check_select_simd<double>();
+
+  std::list<int> l{1, 2, 3, 4, 5};
+  auto odd = utils::select(l, [](int x) { return x % 2 == 1; });
+  EXPECT_TRUE(odd == std::vector<int>({1, 3, 5}));
+
+  // the same buffer is reused across batches
+  std::vector<int> buffer(8);
+  std::vector<int> batch1{1, 2, 3, 4, 5, 6, 7, 8};
+  std::vector<int> batch2{10, 20, 30};
+  auto is_big = [](int x) { return x > 4; };
+  EXPECT_TRUE(utils::select_into(batch1, is_big, buffer) == 4);
+  EXPECT_TRUE(buffer[0] == 5 && buffer[3] == 8);
+  EXPECT_TRUE(utils::select_into(batch2, is_big, buffer) == 3);
+  EXPECT_TRUE(buffer[0] == 10 && buffer[2] == 30);
+  std::vector<int> too_small(2);
+  EXPECT_THROW(utils::select_into(batch1, is_big, too_small),
+               std::runtime_error);
+}
+
+TEST(test, parallel) {
+  std::vector<float> v(1 << 20);
+  std::iota(v.begin(), v.end(), 0.0f);
+  utils::thread_pool pool1(1);
+  utils::thread_pool pool4(4);
+
+  auto m1 = utils::map([](float x) { return x * 2; }, v);
+  auto m2 = utils::map(utils::par, [](float x) { return x * 2; }, v);
+  auto m3 = utils::map(pool4, [](float x) { return x > 100.0f; }, v);
+  EXPECT_TRUE(m1 == m2 && m3.size() == v.size() && !m3[100] && m3[101]);
+
+  auto s1 = utils::select(v, [](float x) { return int(x) % 3 == 0; });
+  auto s2 = utils::select(pool4, v, [](float x) { return int(x) % 3 == 0; });
+  EXPECT_TRUE(s1 == s2);
+
+  // fixed reduction tree: the same bits for any number of threads
+  float sum1 = utils::sum(pool1, v);
+  float sum4 = utils::sum(pool4, v);
+  EXPECT_TRUE(sum1 == sum4 && sum4 == utils::sum(utils::par, v));
+  EXPECT_NEAR(sum4, 549755289600.0f, 549755289600.0f * 1e-6);
+  std::vector<int64_t> vi(100000, 1);
+  EXPECT_TRUE(utils::sum(pool4, vi) == 100000 && utils::prod(pool4, vi) == 1);
+
+  EXPECT_THROW(utils::map(
+                   pool4,
+                   [](float x) {
+                     if (x == 5000.0f) {
+                       throw std::runtime_error("bad element");
+                     }
+                     return x;
+                   },
+                   v),
+               std::runtime_error);
+}
+
 // newton method
 TEST(test, nest) {
   auto sqrt_2 =
@@ -218,6 +721,101 @@ TEST(test, nest) {
   EXPECT_TRUE(sqrt_2 - std::pow(2, 0.5) < 0.0001);
 }
 
+TEST(test, constexpr_algorithms) {
+  constexpr auto r = utils::range<0, 10, 3>();
+  static_assert(std::is_same_v<decltype(r), const std::array<int, 4>>);
+  static_assert(r == std::array<int, 4>{0, 3, 6, 9});
+  static_assert(utils::range<0.0, 1.0, 0.25>().size() == 4);
+  static_assert(utils::range<5, 0>().empty());
+
+  // a lookup table baked into the binary
+  constexpr auto squares =
+      utils::map_array([](int x) { return x * x; }, utils::range<0, 16>());
+  static_assert(std::is_same_v<decltype(squares), const std::array<int, 16>>);
+  static_assert(squares[15] == 225);
+  // map itself keeps returning a vector, also for a std::array input
+  static_assert(std::is_same_v<decltype(utils::map([](int x) { return x; },
+                                                   squares)),
+                               std::vector<int>>);
+  static_assert(utils::sum(squares) == 1240);
+  static_assert(utils::prod(utils::range<1, 6>()) == 120);
+  static_assert(utils::numel(std::array<int, 3>{2, 3, 4}) == 24);
+  static_assert(utils::max(3, 9, -1, 4) == 9 && utils::min(3, 9, -1, 4) == -1);
+  static_assert(utils::max(squares) == 225 && utils::min(squares) == 0);
+  static_assert(utils::minmax(std::array<double, 3>{2.5, -1.0, 7.0}) ==
+                std::pair<double, double>(-1.0, 7.0));
+  static_assert(utils::fold([](int a, int b) { return a * 10 + b; }, 1, 2, 3) ==
+                123);
+  static_assert(utils::fold(std::plus<>{}, utils::range<1, 101>()) == 5050);
+  static_assert(utils::fold_assoc(std::plus<>{}, utils::range<1, 101>()) ==
+                5050);
+  constexpr double sqrt2 =
+      utils::nest([](double x) { return (x + 2.0 / x) / 2.0; }, 1.0, 5);
+  static_assert(sqrt2 > 1.41421356 && sqrt2 < 1.41421357);
+
+  // vector results are usable inside constant evaluation
+  static_assert([] {
+    auto v = utils::range(0, 20, 1);
+    auto odd = utils::select(v, [](int x) { return x % 2 == 1; });
+    auto tail = utils::slice(odd, 5, 10);
+    return utils::sum(utils::map([](int x) { return x + 1; }, tail));
+  }() == 12 + 14 + 16 + 18 + 20);
+
+  // the runtime paths give the same results
+  std::vector<int> v(squares.begin(), squares.end());
+  EXPECT_EQ(utils::sum(v), utils::sum(squares));
+  EXPECT_EQ(utils::max(v), 225);
+}
+
+TEST(test, nest2) {
+  // f runs exactly depth times
+  int calls = 0;
+  auto inc = [&calls](int x) {
+    calls++;
+    return x + 1;
+  };
+  EXPECT_EQ(utils::nest(inc, 0, 0), 0);
+  EXPECT_EQ(utils::nest(inc, 0, 3), 3);
+  EXPECT_EQ(calls, 3);
+  // deep nesting does not grow the stack
+  EXPECT_EQ(utils::nest([](long x) { return x + 1; }, 0L, 10000000), 10000000);
+  // move-only callable
+  auto step = [by = std::make_unique<int>(2)](int x) { return x + *by; };
+  EXPECT_EQ(utils::nest(std::move(step), 1, 4), 9);
+
+  auto powers = utils::nest_list([](int x) { return x * 2; }, 1, 5);
+  EXPECT_EQ(powers, (std::vector<int>{1, 2, 4, 8, 16, 32}));
+  EXPECT_EQ(powers.capacity(), 6);
+  EXPECT_EQ(utils::nest_list(inc, 7, 0), std::vector<int>{7});
+
+  auto newton = [](double x) { return (x + 2.0 / x) / 2.0; };
+  int iterations = 0;
+  auto counted = [&](double x) {
+    iterations++;
+    return newton(x);
+  };
+  double root = utils::fixed_point(counted, 1.0);
+  EXPECT_EQ(root, newton(root));
+  EXPECT_NEAR(root, std::sqrt(2.0), 1e-15);
+  EXPECT_LT(iterations, 10);
+  EXPECT_EQ(utils::fixed_point(counted, 1.0, 2), utils::nest(newton, 1.0, 2));
+  auto close = [](double a, double b) { return std::abs(a - b) < 1e-3; };
+  EXPECT_NEAR(utils::fixed_point(newton, 1.0, 100, close), std::sqrt(2.0),
+              1e-6);
+
+  // collatz: one argument test on the current value
+  auto collatz = [](int n) { return n % 2 == 0 ? n / 2 : 3 * n + 1; };
+  EXPECT_EQ(utils::nest_while(collatz, 27, [](int n) { return n != 1; }), 1);
+  EXPECT_EQ(utils::nest_while(collatz, 27, [](int n) { return n != 1; }, 3),
+            utils::nest(collatz, 27, 3));
+  // two argument test on the last two values
+  EXPECT_EQ(utils::nest_while([](int n) { return n / 2; }, 100,
+                              [](int a, int b) { return a != b; }),
+            0);
+  static_assert(utils::nest_while([](int n) { return n * 3; }, 1,
+                                  [](int n) { return n < 100; }) == 243);
+}
+
 TEST(test, fold) {
   auto factorial10 = utils::fold([](int x, int y) { return x * y; }, 1, 2, 3, 4,
                                  5, 6, 7, 8, 9, 10);
@@ -235,3 +833,709 @@ TEST(test, fold2) {
                   std::vector<int>{1, 2, 3, 4, 5, 6, 7, 8, 9, 10});
   EXPECT_TRUE(factorial10 == 1 * 2 * 3 * 4 * 5 * 6 * 7 * 8 * 9 * 10);
 }
+
+TEST(test, fold3) {
+  // the first element used to be folded in twice
+  EXPECT_TRUE(utils::fold(std::plus<>{}, std::vector<int>{1, 2, 3}) == 6);
+  EXPECT_TRUE(utils::fold(std::plus<>{}, std::list<int>{5}) == 5);
+  EXPECT_THROW(utils::fold(std::plus<>{}, std::vector<int>{}),
+               std::runtime_error);
+
+  static_assert(utils::fold_assoc([](int a, int b) { return a * b; }, 1, 2,
+                                  3, 4, 5) == 120);
+  auto concat = [](std::string a, const std::string &b) { return a + b; };
+  EXPECT_TRUE(utils::fold_assoc(concat, std::string("a"), std::string("b"),
+                                std::string("c")) == "abc");
+
+  // associative but not commutative: the order must be kept
+  std::vector<std::string> words;
+  for (int i = 0; i < 5000; i++) {
+    words.push_back(std::to_string(i % 10));
+  }
+  auto expected = utils::fold(concat, words);
+  utils::thread_pool pool(4);
+  EXPECT_TRUE(utils::fold_assoc(concat, words) == expected);
+  EXPECT_TRUE(utils::fold_assoc(pool, concat, words) == expected);
+
+  // histogram merge over a custom monoid
+  std::vector<std::vector<int>> histograms(20000, std::vector<int>(8, 0));
+  for (size_t i = 0; i < histograms.size(); i++) {
+    histograms[i][i % 8] = 1;
+  }
+  auto merge = [](std::vector<int> a, const std::vector<int> &b) {
+    for (size_t i = 0; i < a.size(); i++) {
+      a[i] += b[i];
+    }
+    return a;
+  };
+  auto merged = utils::fold_assoc(utils::par, merge, histograms);
+  EXPECT_TRUE(merged == std::vector<int>(8, 2500));
+}
+
+template <typename T> void check_mismatch() {
+  for (std::size_t n : {0, 1, 7, 64, 129, 1000}) {
+    std::vector<T> a(n);
+    for (std::size_t i = 0; i < n; ++i) {
+      a[i] = static_cast<T>(i % 100);
+    }
+    auto b = a;
+    EXPECT_TRUE(utils::equals(a, b));
+    EXPECT_EQ(utils::mismatch(a, b), n);
+    for (std::size_t pos = 0; pos < n; pos += 1 + n / 13) {
+      b[pos] = static_cast<T>(b[pos] + 1);
+      EXPECT_FALSE(utils::equals(a, b));
+      EXPECT_EQ(utils::mismatch(a, b), pos);
+      b[pos] = a[pos];
+    }
+    b.push_back(T(1));
+    EXPECT_FALSE(utils::equals(a, b));
+    EXPECT_EQ(utils::mismatch(a, b), n);
+  }
+}
+
+TEST(test, equals_mismatch) {
+  check_mismatch<char>();
+  check_mismatch<int16_t>();
+  check_mismatch<int32_t>();
+  check_mismatch<uint64_t>();
+  check_mismatch<float>();
+  check_mismatch<double>();
+
+  // non-contiguous and mixed inputs
+  std::list<int> l{1, 2, 3, 4};
+  std::vector<long> v{1, 2, 3, 5};
+  EXPECT_EQ(utils::mismatch(l, v), 3);
+  EXPECT_FALSE(utils::equals(l, v));
+  EXPECT_TRUE(utils::equals(l, std::vector<int>{1, 2, 3, 4}));
+  EXPECT_TRUE(utils::equals(utils::views::range(0, 5), utils::range(0, 5)));
+  static_assert(utils::equals(std::array<int, 3>{1, 2, 3},
+                              std::array<int, 3>{1, 2, 3}));
+  static_assert(utils::mismatch(std::array<int, 3>{1, 2, 3},
+                                std::array<int, 2>{1, 5}) == 1);
+
+  // IEEE semantics: -0.0 equals 0.0, NaN equals nothing
+  std::vector<double> zeros{0.0, 1.0}, negative_zeros{-0.0, 1.0};
+  EXPECT_TRUE(utils::equals(zeros, negative_zeros));
+  std::vector<float> nans(100, 1.0f);
+  nans[70] = std::numeric_limits<float>::quiet_NaN();
+  EXPECT_EQ(utils::mismatch(nans, nans), 70);
+}
+
+utils::generator<double> tenths(int n) {
+  for (int i = 0; i < n; ++i) {
+    co_yield 0.1 * i;
+  }
+}
+
+TEST(test, approx_equals) {
+  std::vector<double> a(1000), b(1000);
+  for (std::size_t i = 0; i < a.size(); ++i) {
+    a[i] = std::sin(static_cast<double>(i + 1)) * 1e3;
+    b[i] = std::nextafter(std::nextafter(a[i], 1e9), 1e9); // 2 ulps
+  }
+  EXPECT_FALSE(utils::equals(a, b));
+  EXPECT_TRUE(utils::approx_equals(a, b));
+  EXPECT_FALSE(utils::approx_equals(a, b, {.ulps = 1}));
+  EXPECT_EQ(utils::mismatch(a, b, {.ulps = 1}), 0);
+  EXPECT_TRUE(utils::approx_equals(a, b, {.relative = 1e-12, .ulps = 0}));
+
+  b[517] += 1e-3;
+  EXPECT_EQ(utils::mismatch(a, b, {}), 517);
+  EXPECT_TRUE(utils::approx_equals(a, b, {.relative = 1e-5}));
+  EXPECT_TRUE(utils::approx_equals(a, b, {.absolute = 2e-3}));
+  b[900] = std::numeric_limits<double>::quiet_NaN();
+  EXPECT_EQ(utils::mismatch(a, b, {.absolute = 2e-3}), 900);
+  b.pop_back();
+  EXPECT_FALSE(utils::approx_equals(a, b, {.absolute = 1e9}));
+
+  // the ulp distance crosses zero and works for float
+  float tiny = std::numeric_limits<float>::denorm_min();
+  EXPECT_TRUE(utils::approx_equals(tiny, -tiny, {.ulps = 2}));
+  EXPECT_FALSE(utils::approx_equals(tiny, -tiny, {.ulps = 1}));
+  EXPECT_TRUE(utils::approx_equals(0.1f + 0.2f, 0.3f));
+  std::vector<float> f1(333, 0.3f), f2(333, 0.1f + 0.2f);
+  EXPECT_TRUE(utils::approx_equals(f1, f2));
+  EXPECT_TRUE(utils::approx_equals(std::list<float>(f1.begin(), f1.end()), f2));
+  // a generator can only be walked once
+  std::vector<double> t{0.0, 0.1, 0.2, 0.30000000000000004};
+  EXPECT_TRUE(utils::approx_equals(tenths(4), t));
+  EXPECT_TRUE(utils::approx_equals(t, tenths(4)));
+  EXPECT_FALSE(utils::approx_equals(tenths(3), t));
+  EXPECT_FALSE(utils::approx_equals(tenths(5), t));
+  t[2] = 0.25;
+  EXPECT_FALSE(utils::approx_equals(tenths(4), t));
+  float inf = std::numeric_limits<float>::infinity();
+  EXPECT_TRUE(utils::approx_equals(inf, inf));
+  EXPECT_FALSE(utils::approx_equals(inf, -inf));
+}
+
+TEST(test, range_view) {
+  auto r = utils::range(0, 10, 3);
+  static_assert(std::ranges::random_access_range<decltype(r)> &&
+                std::ranges::view<decltype(r)>);
+  EXPECT_TRUE(r.size() == 4 && r[0] == 0 && r[3] == 9);
+  EXPECT_TRUE(utils::equals(r, std::vector<int>{0, 3, 6, 9}));
+  EXPECT_TRUE(utils::equals(utils::range(5, 0, -2), std::vector<int>{5, 3, 1}));
+  EXPECT_TRUE(utils::range(0, 5, -1).empty() && utils::range(5, 0).empty());
+  EXPECT_THROW(utils::range(0, 5, 0), std::runtime_error);
+  // more elements than size_t can count
+  EXPECT_THROW(utils::range(0.0, 1e300, 1e-10), std::length_error);
+  EXPECT_THROW(utils::range(0.0, std::numeric_limits<double>::infinity()),
+               std::length_error);
+  EXPECT_EQ(utils::range(std::numeric_limits<int>::min(),
+                             std::numeric_limits<int>::max(), 1 << 30).size(), 4);
+  // i * step overflows int here, the elements themselves do not
+  constexpr int int_min = std::numeric_limits<int>::min();
+  constexpr int int_max = std::numeric_limits<int>::max();
+  auto quarters = utils::range(int_min, int_max, 1 << 30);
+  EXPECT_TRUE(utils::equals(quarters,
+                            std::vector<int>{int_min, -(1 << 30), 0, 1 << 30}));
+  EXPECT_EQ(*std::ranges::prev(quarters.end()), 1 << 30);
+  auto down = utils::range(int_max, int_min, -(1 << 30));
+  EXPECT_TRUE(down.size() == 4 && down[3] == -(1 << 30) - 1);
+
+  // no drift: values are start + i * step, not repeated additions
+  auto tenths = utils::range(0.0, 1.0, 0.1);
+  EXPECT_EQ(tenths.size(), 10);
+  EXPECT_EQ(tenths[7], 0.0 + 7 * 0.1);
+
+  // closed form sum, also for sizes that can not be materialized
+  EXPECT_EQ(utils::sum(utils::range(1, 101)), 5050);
+  EXPECT_EQ(utils::sum(utils::range(10, -11, -3)), 10 + 7 + 4 + 1 - 2 - 5 - 8);
+  EXPECT_EQ(utils::sum(utils::range(int64_t(0), int64_t(1'000'000'000))),
+            int64_t(499'999'999'500'000'000));
+  EXPECT_EQ(utils::sum(utils::par, utils::range(int64_t(0), int64_t(1) << 30)),
+            ((int64_t(1) << 30) - 1) * (int64_t(1) << 29));
+  uint32_t wrapped = 0;
+  for (auto x : utils::range(uint32_t(0), uint32_t(100000), uint32_t(7))) {
+    wrapped += x;
+  }
+  EXPECT_EQ(utils::sum(utils::range(uint32_t(0), uint32_t(100000), uint32_t(7))),
+            wrapped);
+  EXPECT_DOUBLE_EQ(utils::sum(utils::range(0.5, 100.0, 0.5)),
+                   utils::sum(utils::range(0.5, 100.0, 0.5) | utils::to_vector()));
+  static_assert(utils::sum(utils::range(0, 10)) == 45);
+
+  // sub-ranges for parallel loops
+  auto parts = utils::range(0, 100, 3).split(4);
+  EXPECT_EQ(parts.size(), 4);
+  std::vector<int> joined;
+  for (auto &part : parts) {
+    EXPECT_TRUE(part.size() == 8 || part.size() == 9);
+    joined.insert(joined.end(), part.begin(), part.end());
+  }
+  EXPECT_TRUE(utils::equals(joined, utils::range(0, 100, 3)));
+  EXPECT_EQ(utils::range(0, 3).split(8).size(), 3);
+  EXPECT_TRUE(utils::equals(utils::range(0, 100, 3).subrange(2, 4),
+                            std::vector<int>{6, 9}));
+
+  // equals compares progressions by start and step
+  EXPECT_TRUE(utils::equals(utils::range(0, 10, 3), utils::range(0, 11, 3)));
+  EXPECT_FALSE(utils::equals(utils::range(0, 10, 3), utils::range(1, 11, 3)));
+  EXPECT_TRUE(utils::equals(utils::range(7, 8, 1), utils::range(7, 0, -9)));
+  EXPECT_TRUE(utils::equals(utils::map([](int x) { return x * 2; },
+                                       utils::range(0, 5)),
+                            utils::range(0, 10, 2)));
+  EXPECT_TRUE(utils::equals(
+      utils::map(utils::par, [](int x) { return x * 2; }, utils::range(0, 5000)),
+      utils::range(0, 10000, 2)));
+}
+
+TEST(test, slice2) {
+  std::vector<int> v{0, 1, 2, 3, 4, 5, 6, 7, 8, 9};
+  auto none = std::nullopt;
+  // python semantics: v[2:8:3], v[-3:], v[::-1], v[8:2:-2], v[-100:3]
+  EXPECT_TRUE(utils::equals(utils::slice(v, 2, 8, 3), std::vector<int>{2, 5}));
+  EXPECT_TRUE(
+      utils::equals(utils::slice(v, -3, none), std::vector<int>{7, 8, 9}));
+  EXPECT_TRUE(utils::equals(utils::slice(v, none, none, -1),
+                            utils::range(9, -1, -1)));
+  EXPECT_TRUE(
+      utils::equals(utils::slice(v, 8, 2, -2), std::vector<int>{8, 6, 4}));
+  EXPECT_TRUE(
+      utils::equals(utils::slice(v, -100, 3), std::vector<int>{0, 1, 2}));
+  EXPECT_TRUE(utils::slice(v, 5, 2).empty() &&
+              utils::slice(v, 2, 5, -1).empty());
+  EXPECT_TRUE(utils::slice(std::vector<int>{}, none, none, -1).empty());
+  EXPECT_THROW(utils::slice(v, 0, 5, 0), std::runtime_error);
+
+  // a view into v: writes go through, sum/map/select read in place
+  auto odd = utils::slice(v, 1, none, 2);
+  static_assert(std::ranges::view<decltype(odd)>);
+  EXPECT_EQ(utils::sum(odd), 1 + 3 + 5 + 7 + 9);
+  EXPECT_TRUE(utils::equals(utils::map([](int x) { return x * x; }, odd),
+                            std::vector<int>{1, 9, 25, 49, 81}));
+  EXPECT_TRUE(utils::equals(utils::select(odd, [](int x) { return x > 4; }),
+                            std::vector<int>{5, 7, 9}));
+  for (auto &x : utils::slice(v, none, none, -3)) {
+    x = -x;
+  }
+  EXPECT_TRUE(
+      utils::equals(v, std::vector<int>{0, 1, 2, -3, 4, 5, -6, 7, 8, -9}));
+  EXPECT_TRUE(utils::equals(utils::slice(v, -1, 0, -3, std::allocator<int>()),
+                            std::vector<int>{-9, -6, -3}));
+
+  // strided sums and extrema go through the SIMD kernels in chunks
+  std::vector<double> big(3001);
+  for (std::size_t i = 0; i < big.size(); ++i) {
+    big[i] = static_cast<double>(i);
+  }
+  EXPECT_EQ(utils::sum(utils::slice(big, 1000, none)), 2001 * 2000.0);
+  EXPECT_EQ(utils::sum(utils::slice(big, none, none, -2)), 1501 * 1500.0);
+  EXPECT_EQ(utils::minmax(utils::slice(big, 10, -10, 7)),
+            std::make_pair(10.0, 2985.0));
+
+  // nested containers and tensors along a deeper axis, rows are not copied
+  std::vector<std::vector<int>> m{{1, 2, 3, 4}, {5, 6, 7, 8}, {9, 10, 11, 12}};
+  auto last_column = utils::slice<1>(m, -1, none);
+  EXPECT_EQ(utils::sum(last_column), 4 + 8 + 12);
+  auto inner = utils::slice<1>(utils::slice(m, none, none, -2), 1, 3);
+  EXPECT_TRUE(std::ranges::distance(inner) == 2 &&
+              utils::equals(*inner.begin(), std::vector<int>{10, 11}) &&
+              utils::equals(*std::next(inner.begin()), std::vector<int>{2, 3}));
+  (*inner.begin())[0] = 0;
+  EXPECT_EQ(m[2][1], 0);
+  auto t = utils::to_tensor(m);
+  auto reversed_columns = utils::slice<1>(t, none, none, -1);
+  EXPECT_TRUE(utils::Tensor<decltype(reversed_columns)>);
+  EXPECT_EQ(reversed_columns(0, 0), 4);
+  EXPECT_EQ(utils::sum(utils::slice<1>(t, none, none, -2)),
+            4 + 2 + 8 + 6 + 12 + 0);
+  EXPECT_EQ(utils::sum(utils::slice(t, -1, none)), 9 + 0 + 11 + 12);
+
+  // usable in constant evaluation
+  static_assert([] {
+    std::array<int, 6> a{1, 2, 3, 4, 5, 6};
+    return utils::sum(utils::slice(a, std::nullopt, std::nullopt, -2));
+  }() == 6 + 4 + 2);
+}
+
+TEST(test, fold_list) {
+  std::vector<int> v{1, 2, 3, 4, 5};
+  EXPECT_TRUE(utils::equals(utils::accumulate_list(v),
+                            std::vector<int>{1, 3, 6, 10, 15}));
+  EXPECT_TRUE(utils::equals(
+      utils::fold_list([](int a, int b) { return a * 10 + b; }, v),
+      std::vector<int>{1, 12, 123, 1234, 12345}));
+  // with a start value: sizes to offsets, the total at the end
+  EXPECT_TRUE(utils::equals(utils::fold_list(std::plus<>{}, 0, v),
+                            std::vector<int>{0, 1, 3, 6, 10, 15}));
+  EXPECT_TRUE(utils::fold_list(std::plus<>{}, std::vector<int>{}).empty());
+  EXPECT_EQ(utils::fold_list(std::plus<>{}, 7, std::vector<int>{}).size(), 1);
+  std::list<std::string> words{"a", "b", "c"};
+  EXPECT_TRUE(utils::fold_list(std::plus<>{}, words) ==
+              (std::vector<std::string>{"a", "ab", "abc"}));
+  static_assert(utils::accumulate_list(utils::range<1, 5>()).back() == 10);
+
+  // the SIMD kernel against a plain loop, all lengths around the vector width
+  auto check = [](auto zero) {
+    using T = decltype(zero);
+    for (std::size_t n = 0; n < 70; ++n) {
+      std::vector<T> x(n);
+      std::vector<T> expected(n);
+      T acc = T(0);
+      for (std::size_t i = 0; i < n; ++i) {
+        x[i] = static_cast<T>((i * 7) % 11) - T(3);
+        acc += x[i];
+        expected[i] = acc;
+      }
+      EXPECT_TRUE(utils::equals(utils::accumulate_list(x), expected));
+      // in place
+      utils::accumulate_list_into(x, x);
+      EXPECT_TRUE(utils::equals(x, expected));
+    }
+  };
+  check(int32_t(0));
+  check(int64_t(0));
+  check(float(0));
+  check(double(0));
+  check(int16_t(0));
+  std::vector<int> small(3);
+  EXPECT_THROW(utils::accumulate_list_into(v, small), std::runtime_error);
+
+  // the parallel two pass scan matches the sequential one
+  std::vector<int64_t> big(1'000'003);
+  for (std::size_t i = 0; i < big.size(); ++i) {
+    big[i] = static_cast<int64_t>(i % 1000) - 500;
+  }
+  auto sequential = utils::accumulate_list(big);
+  EXPECT_TRUE(utils::equals(utils::accumulate_list(utils::par, big),
+                            sequential));
+  std::vector<int64_t> out(big.size());
+  utils::accumulate_list_into(utils::par, big, out);
+  EXPECT_TRUE(utils::equals(out, sequential));
+  // associative but not commutative: 2x2 matrix products (mod 2^64)
+  using mat = std::array<uint64_t, 4>;
+  auto mul = [](const mat &a, const mat &b) {
+    return mat{a[0] * b[0] + a[1] * b[2], a[0] * b[1] + a[1] * b[3],
+               a[2] * b[0] + a[3] * b[2], a[2] * b[1] + a[3] * b[3]};
+  };
+  std::vector<mat> mats(100'000);
+  for (std::size_t i = 0; i < mats.size(); ++i) {
+    mats[i] = i % 2 ? mat{1, 1, 0, 1} : mat{1, 0, uint64_t(i % 3), 1};
+  }
+  EXPECT_TRUE(utils::fold_list(utils::par, mul, mats) ==
+              utils::fold_list(mul, mats));
+}
+
+TEST(test, dot) {
+  std::vector<std::vector<int>> m{{1, 2}, {3, 4}, {5, 6}};
+  std::vector<int> v{1, -1};
+  EXPECT_EQ(utils::dot(v, v), 2);
+  EXPECT_TRUE(utils::equals(utils::dot(m, v), std::vector<int>{-1, -1, -1}));
+  EXPECT_TRUE(utils::equals(utils::dot(std::vector<int>{1, 0, 1}, m),
+                            std::vector<int>{6, 8}));
+  EXPECT_TRUE(utils::dot(m, std::vector<std::vector<int>>{{1, 0}, {0, 1}}) ==
+              m);
+  // mixed element types use the common type
+  EXPECT_DOUBLE_EQ(utils::dot(v, std::vector<double>{0.5, 0.25}), 0.25);
+  EXPECT_THROW(utils::dot(v, std::vector<int>{1, 2, 3}), std::runtime_error);
+  EXPECT_THROW(utils::dot(m, m), std::runtime_error);
+
+  // tensor operands give tensors, transposed views are not copied
+  auto t = utils::to_tensor(m);
+  utils::tensor<int, 2> gram = utils::dot(t.transpose(), t);
+  EXPECT_TRUE(gram.to_nested() ==
+              (std::vector<std::vector<int>>{{35, 44}, {44, 56}}));
+  EXPECT_TRUE(
+      utils::equals(utils::dot(t.transpose(), std::vector<int>{1, 1, 1}),
+                    std::vector<int>{9, 12}));
+
+  // the packed kernel against a plain loop, sizes around the block edges
+  auto check = [](auto zero, std::size_t rows, std::size_t inner,
+                  std::size_t cols) {
+    using T = decltype(zero);
+    utils::tensor<T, 2> a(rows, inner);
+    utils::tensor<T, 2> b(inner, cols);
+    for (std::size_t i = 0; i < a.size(); ++i) {
+      a.data()[i] = static_cast<T>(static_cast<int>(i % 7) - 3);
+    }
+    for (std::size_t i = 0; i < b.size(); ++i) {
+      b.data()[i] = static_cast<T>(static_cast<int>((i * 5) % 11) - 5);
+    }
+    utils::tensor<T, 2> expected(rows, cols);
+    for (std::size_t i = 0; i < rows; ++i) {
+      for (std::size_t p = 0; p < inner; ++p) {
+        for (std::size_t j = 0; j < cols; ++j) {
+          expected(i, j) += a(i, p) * b(p, j);
+        }
+      }
+    }
+    EXPECT_TRUE(utils::dot(a, b) == expected);
+    EXPECT_TRUE(utils::dot(utils::par, a, b) == expected);
+    utils::tensor<T, 2> bt(b.transpose());
+    EXPECT_TRUE(utils::dot(a, bt.transpose()) == expected);
+    EXPECT_TRUE(utils::equals(utils::dot(a, bt[0]),
+                              utils::dot(utils::par, a, bt[0])));
+  };
+  for (auto [rows, inner, cols] :
+       std::vector<std::array<std::size_t, 3>>{
+           {1, 1, 1}, {13, 300, 17}, {97, 257, 70}, {200, 3, 2050}}) {
+    check(int32_t(0), rows, inner, cols);
+    check(int64_t(0), rows, inner, cols);
+    check(float(0), rows, inner, cols);
+    check(double(0), rows, inner, cols);
+  }
+
+  // inner with other f and g: min-plus product, boolean reachability
+  auto min_of = [](int a, int b) { return std::min(a, b); };
+  std::vector<std::vector<int>> d{{0, 4, 9}, {4, 0, 2}, {9, 2, 0}};
+  EXPECT_TRUE(
+      utils::inner(std::plus<>{}, min_of, d, d) ==
+      (std::vector<std::vector<int>>{{0, 4, 6}, {4, 0, 2}, {6, 2, 0}}));
+  EXPECT_EQ(utils::inner(std::plus<>{}, std::multiplies<>{}, v, v), -4);
+  EXPECT_EQ(utils::inner(std::multiplies<>{}, std::plus<>{}, v, v), 2);
+  EXPECT_THROW(utils::inner(std::plus<>{}, min_of, std::vector<int>{},
+                            std::vector<int>{}),
+               std::runtime_error);
+
+  auto table = utils::outer(std::multiplies<>{}, std::vector<int>{1, 2},
+                            std::vector<double>{1, 0.5, 0.25});
+  EXPECT_TRUE(table == (std::vector<std::vector<double>>{{1, 0.5, 0.25},
+                                                         {2, 1, 0.5}}));
+  auto less = utils::outer(std::less<>{}, std::vector<int>{1, 2},
+                           std::vector<int>{1, 2, 3});
+  EXPECT_TRUE(less == (std::vector<std::vector<bool>>{{false, true, true},
+                                                      {false, false, true}}));
+  utils::tensor<int, 2> sums =
+      utils::outer(std::plus<>{}, t[0], std::vector<int>{10, 20});
+  EXPECT_TRUE(sums.to_nested() ==
+              (std::vector<std::vector<int>>{{11, 21}, {12, 22}}));
+}
+
+utils::generator<int> naturals() {
+  for (int i = 0;; ++i) {
+    co_yield i;
+  }
+}
+
+utils::generator<int> count_to(int n) {
+  for (int i = 1; i <= n; ++i) {
+    co_yield i;
+  }
+}
+
+// 2^depth ones through nested generators
+utils::generator<int> ones(int depth) {
+  if (depth == 0) {
+    co_yield 1;
+    co_return;
+  }
+  co_yield utils::elements_of(ones(depth - 1));
+  co_yield utils::elements_of(ones(depth - 1));
+}
+
+utils::generator<int> chain(int depth) {
+  if (depth == 0) {
+    co_yield 7;
+  } else {
+    co_yield utils::elements_of(chain(depth - 1));
+  }
+}
+
+utils::generator<std::string> failing() {
+  co_yield "ok";
+  throw std::runtime_error("source failed");
+}
+
+TEST(test, generator) {
+  EXPECT_EQ(utils::sum(count_to(100)), 5050);
+  EXPECT_EQ(utils::prod(count_to(5)), 120);
+  auto [lo, hi] = utils::minmax(count_to(9));
+  EXPECT_EQ(lo, 1);
+  EXPECT_EQ(hi, 9);
+  EXPECT_EQ(utils::fold(std::plus<>{}, count_to(4)), 10);
+
+  // map and select of an unbounded stream stay lazy
+  auto odd_squares = utils::select(
+      utils::map([](int x) { return x * x; }, naturals()),
+      [](int x) { return x % 2 == 1; });
+  std::vector<int> first;
+  for (int x : odd_squares) {
+    if (first.size() == 4) {
+      break;
+    }
+    first.push_back(x);
+  }
+  EXPECT_TRUE(utils::equals(first, std::vector<int>{1, 9, 25, 49}));
+  // an lvalue generator is referenced, not copied
+  auto numbers = count_to(3);
+  EXPECT_EQ(utils::sum(utils::map([](int x) { return 2 * x; }, numbers)), 12);
+
+  std::vector<std::pair<uint64_t, int>> indexed;
+  for (auto [i, x] : utils::enumerate(count_to(3))) {
+    indexed.emplace_back(i, x);
+  }
+  EXPECT_TRUE(indexed == (std::vector<std::pair<uint64_t, int>>{
+                             {0, 1}, {1, 2}, {2, 3}}));
+  std::vector<std::string> names{"a", "b"};
+  std::string zipped;
+  for (auto [x, name] : utils::zip(naturals(), names)) {
+    zipped += name + std::to_string(x);
+  }
+  EXPECT_EQ(zipped, "a0b1");
+
+  // nested generators, deep recursion resumes the innermost one directly
+  EXPECT_EQ(utils::sum(ones(12)), 4096);
+  EXPECT_EQ(utils::sum(chain(100'000)), 7);
+
+  std::vector<std::string> seen;
+  auto source = failing();
+  EXPECT_THROW(
+      for (auto &s : source) { seen.push_back(s); }, std::runtime_error);
+  EXPECT_TRUE(seen == std::vector<std::string>{"ok"});
+
+  // finished frames are reused
+  auto &pool = utils::detail::frame_pool::local();
+  void *frame = pool.allocate(200);
+  pool.deallocate(frame, 200);
+  EXPECT_EQ(pool.allocate(256), frame);
+  pool.deallocate(frame, 256);
+}
+
+TEST(test, memoize) {
+  int calls = 0;
+  auto square = utils::memoize([&](int x) {
+    ++calls;
+    return x * x;
+  });
+  EXPECT_EQ(square(3), 9);
+  EXPECT_EQ(square(3), 9);
+  EXPECT_EQ(square(4), 16);
+  EXPECT_EQ(calls, 2);
+  auto stats = square.stats();
+  EXPECT_EQ(stats.hits, 1u);
+  EXPECT_EQ(stats.misses, 2u);
+  EXPECT_EQ(stats.size, 2u);
+  // copies share the cache
+  auto copy = square;
+  EXPECT_EQ(copy(4), 16);
+  EXPECT_EQ(calls, 2);
+  square.clear();
+  EXPECT_EQ(square(4), 16);
+  EXPECT_EQ(calls, 3);
+
+  // least recently used first
+  calls = 0;
+  auto lru = utils::memoize(
+      [&](int x) {
+        ++calls;
+        return x + 1;
+      },
+      {.capacity = 2, .shards = 1});
+  lru(1), lru(2), lru(1), lru(3);
+  EXPECT_EQ(lru.stats().evictions, 1u);
+  lru(1);
+  EXPECT_EQ(calls, 3);
+  lru(2);
+  EXPECT_EQ(calls, 4);
+
+  auto concat = utils::memoize<std::string, int>(
+      [](const auto &s, auto n) {
+        std::string out;
+        for (int i = 0; i < n; ++i) {
+          out += s;
+        }
+        return out;
+      });
+  EXPECT_EQ(concat("ab", 3), "ababab");
+  EXPECT_EQ(concat("ab", 3), "ababab");
+  EXPECT_EQ(concat.stats().hits, 1u);
+
+  auto failing = utils::memoize([](int x) -> int {
+    if (x < 0) {
+      throw std::runtime_error("negative");
+    }
+    return x;
+  });
+  EXPECT_THROW(failing(-1), std::runtime_error);
+  EXPECT_EQ(failing.stats().size, 0u);
+
+  std::atomic<int> evaluations{0};
+  auto slow = utils::memoize([&](int x) {
+    ++evaluations;
+    return static_cast<long>(x) * 3;
+  });
+  std::vector<int> keys(100'000);
+  for (std::size_t i = 0; i < keys.size(); ++i) {
+    keys[i] = static_cast<int>(i % 100);
+  }
+  auto tripled = utils::map(utils::par, slow, keys);
+  for (std::size_t i = 0; i < keys.size(); ++i) {
+    ASSERT_EQ(tripled[i], keys[i] * 3L);
+  }
+  stats = slow.stats();
+  EXPECT_EQ(stats.hits + stats.misses, keys.size());
+  EXPECT_EQ(stats.size, 100u);
+  EXPECT_EQ(static_cast<std::uint64_t>(evaluations.load()), stats.misses);
+
+  auto collatz = utils::memoize([](long n) {
+    return n % 2 == 0 ? n / 2 : 3 * n + 1;
+  });
+  EXPECT_EQ(utils::nest(collatz, 27L, 111), 1);
+  EXPECT_EQ(utils::nest(collatz, 27L, 111), 1);
+  EXPECT_EQ(collatz.stats().misses, 111u);
+}
+
+TEST(test, instrumentation) {
+  // every value lands in a bucket whose floor is within 1/16 below it
+  using histogram = utils::latency_histogram;
+  for (std::uint64_t v : {0ull, 15ull, 16ull, 17ull, 1000ull, 123456789ull}) {
+    std::size_t b = histogram::bucket_of(v);
+    EXPECT_TRUE(histogram::bucket_floor(b) <= v &&
+                v < histogram::bucket_floor(b + 1));
+    EXPECT_TRUE(v - histogram::bucket_floor(b) <= v / 16);
+  }
+  histogram h;
+  for (std::uint64_t v = 1; v <= 1000; ++v) {
+    h.record(v * 100);
+  }
+  EXPECT_TRUE(h.count() == 1000 && h.min() == 100 && h.max() == 100000);
+  EXPECT_NEAR(h.percentile(0.5), 50000, 50000 / 16);
+  EXPECT_NEAR(h.percentile(0.99), 99000, 99000 / 16);
+  EXPECT_EQ(h.percentile(1.0), 100000);
+
+#if UTILS_INSTRUMENT
+  utils::probe_reset();
+  utils::probe_tracing(true);
+  std::vector<int> v(100000, 1);
+  std::vector<std::vector<int>> nested(10, std::vector<int>(10, 1));
+  for (int i = 0; i < 3; ++i) {
+    EXPECT_EQ(utils::sum(v), 100000);
+  }
+  // the chunks of a parallel sum and the rows of a nested one are not calls
+  EXPECT_EQ(utils::sum(utils::par, v), 100000);
+  EXPECT_EQ(utils::sum(nested), 100);
+  utils::map(utils::par, [](int x) { return x + 1; }, v);
+  utils::probe_tracing(false);
+  EXPECT_EQ(utils::sum(v), 100000);
+
+  auto stats = utils::probe_snapshot();
+  auto find = [&](std::string_view name) {
+    return *std::ranges::find(stats, name, &utils::probe_stats::name);
+  };
+  EXPECT_EQ(stats.size(), 2);
+  auto sum_stats = find("sum");
+  EXPECT_TRUE(sum_stats.calls == 6 && sum_stats.latency.count() == 6);
+  EXPECT_EQ(sum_stats.elements, 5 * 100000);
+  EXPECT_EQ(sum_stats.bytes, 5 * 100000 * sizeof(int));
+  EXPECT_TRUE(sum_stats.total_ns >= sum_stats.latency.max());
+  EXPECT_EQ(find("map").calls, 1);
+  auto json = utils::to_json(stats);
+  EXPECT_NE(json.find("\"name\": \"map\", \"calls\": 1"), std::string::npos);
+  // the last sum ran with tracing off
+  auto trace = utils::probe_trace_json();
+  std::size_t events = 0;
+  for (auto pos = trace.find("\"ph\": \"X\""); pos != std::string::npos;
+       pos = trace.find("\"ph\": \"X\"", pos + 1)) {
+    ++events;
+  }
+  EXPECT_EQ(events, 6);
+
+  // the accurate sums are sum calls too, the rows of a nested one are not
+  utils::probe_reset();
+  std::vector<double> d(1000, 0.5);
+  std::vector<std::vector<double>> nested_d(4, d);
+  EXPECT_EQ(utils::sum(utils::kahan, d), 500.0);
+  EXPECT_EQ(utils::sum(utils::pairwise, d), 500.0);
+  EXPECT_EQ(utils::sum(utils::kahan, nested_d), 2000.0);
+  EXPECT_EQ(utils::sum(utils::pairwise, nested_d), 2000.0);
+  EXPECT_EQ(utils::sum(utils::kahan, v), 100000);
+  stats = utils::probe_snapshot();
+  EXPECT_EQ(find("sum").calls, 5);
+
+  // constant evaluation is never probed
+  static_assert(utils::sum(std::array<int, 3>{1, 2, 3}) == 6);
+  utils::probe_reset();
+  EXPECT_TRUE(utils::probe_snapshot().empty());
+#else
+  EXPECT_EQ(utils::sum(std::vector<int>(10, 1)), 10);
+  EXPECT_TRUE(utils::probe_snapshot().empty());
+  EXPECT_EQ(utils::probe_trace_json().find("\"ph\""), std::string::npos);
+#endif
+}
+
+TEST(test, benchmark) {
+  std::vector<int> v(1000, 1);
+  utils::benchmark_options options;
+  options.warmup_runs = 1;
+  options.samples = 10;
+  options.min_sample_time = std::chrono::microseconds(200);
+  options.bytes_per_call = v.size() * sizeof(int);
+  auto result = utils::benchmark(
+      "sum \"1k\"", options,
+      [](const std::vector<int> &c) { return utils::sum(c); }, v);
+  EXPECT_TRUE(result.samples == 10 && result.iterations_per_sample >= 1);
+  EXPECT_TRUE(result.min_ns > 0 && result.min_ns <= result.median_ns &&
+              result.median_ns <= result.p90_ns &&
+              result.p90_ns <= result.p99_ns && result.p99_ns <= result.max_ns);
+  EXPECT_TRUE(result.bytes_per_second > 0 && result.items_per_second == 0);
+  auto json = utils::to_json({result});
+  EXPECT_TRUE(json.find(R"("name": "sum \"1k\"")") != std::string::npos);
+  EXPECT_TRUE(json.find("\"median_ns\": ") != std::string::npos);
+  utils::println(result.to_string());
+
+  int calls = 0;
+  utils::timeit([&calls] { calls++; });
+  EXPECT_TRUE(calls > 30);
+}
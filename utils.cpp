@@ -0,0 +1,4 @@
+// explicit instantiations of the common utils.h templates, see
+// UTILS_PRECOMPILED at the end of utils.h
+#define UTILS_INSTANTIATE
+#include "utils.h"
@@ -0,0 +1,124 @@
+// import utils; — the utils.h API as a C++20 module. the header is compiled
+// once into the module interface, importers neither re-parse it nor see its
+// macros or the std headers it includes.
+module;
+#include "utils.h"
+export module utils;
+
+export namespace utils {
+// concepts
+using utils::AnyInput;
+using utils::Arithmetic;
+using utils::Comparable;
+using utils::ContainerWithArithmeticElement;
+using utils::ContainerWithComparableElement;
+using utils::ContainerWithPrintableElement;
+using utils::ExecutionPolicy;
+using utils::Generator;
+using utils::NestedContainerWithArithmeticElement;
+using utils::NestedContainerWithPrintableElement;
+using utils::OutputSink;
+using utils::PrintableElement;
+using utils::RangeView;
+using utils::ResultAllocator;
+using utils::Tensor;
+
+// types and tags
+using utils::access_pattern;
+using utils::arena_scope;
+using utils::benchmark_options;
+using utils::benchmark_result;
+using utils::bump_arena;
+using utils::elements_of;
+using utils::enumerate;
+using utils::fd_sink;
+using utils::generator;
+using utils::kahan;
+using utils::kahan_t;
+using utils::latency_histogram;
+using utils::mapped_array;
+using utils::memoize_options;
+using utils::memoize_stats;
+using utils::memoized;
+using utils::nan_policy;
+using utils::pairwise;
+using utils::pairwise_t;
+using utils::par;
+using utils::par_t;
+using utils::probe;
+using utils::probe_count;
+using utils::probe_names;
+using utils::probe_stats;
+using utils::range_view;
+using utils::slice_view;
+using utils::streamed_array;
+using utils::summary;
+using utils::tensor;
+using utils::tensor_view;
+using utils::thread_pool;
+using utils::tolerance;
+using utils::zip;
+
+// functions
+using utils::accumulate_list;
+using utils::accumulate_list_into;
+using utils::approx_equals;
+using utils::argmax;
+using utils::argmin;
+using utils::benchmark;
+using utils::clobber_memory;
+using utils::do_not_optimize;
+using utils::dot;
+using utils::equals;
+using utils::fixed_point;
+using utils::fold;
+using utils::fold_assoc;
+using utils::fold_list;
+using utils::fold_list_into;
+using utils::inner;
+using utils::make_index_tuple;
+using utils::map;
+using utils::map_array;
+using utils::max;
+using utils::memoize;
+using utils::min;
+using utils::minmax;
+using utils::mismatch;
+using utils::nest;
+using utils::nest_list;
+using utils::nest_while;
+using utils::numel;
+using utils::outer;
+using utils::Print;
+using utils::print;
+using utils::print_to;
+using utils::Println;
+using utils::println;
+using utils::println_to;
+using utils::probe_reset;
+using utils::probe_snapshot;
+using utils::probe_trace_json;
+using utils::probe_tracing;
+using utils::prod;
+using utils::range;
+using utils::select;
+using utils::select_into;
+using utils::shape_to_string;
+using utils::slice;
+using utils::sum;
+using utils::thread_arena;
+using utils::timeit;
+using utils::to_json;
+using utils::to_tensor;
+using utils::to_vector;
+using utils::vunpack;
+} // namespace utils
+
+// the lazy counterparts, composed with |
+export namespace utils::views {
+using utils::views::enumerate;
+using utils::views::map;
+using utils::views::range;
+using utils::views::select;
+using utils::views::slice;
+} // namespace utils::views
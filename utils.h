@@ -1,34 +1,74 @@
 #ifndef _UTILS_H_
 #define _UTILS_H_
 
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
 #include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <coroutine>
+#include <cerrno>
+#include <charconv>
 #include <concepts>
 #include <cstddef>
 #include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <exception>
+#include <functional>
 #include <iomanip>
 #include <iostream>
+#include <iterator>
+#include <limits>
+#include <memory>
+#include <memory_resource>
+#include <mutex>
+#include <new>
 #include <numeric>
+#include <optional>
 #include <ostream>
+#include <ranges>
+#include <span>
 #include <sstream>
+#include <stdexcept>
 #include <string>
+#include <string_view>
+#include <thread>
 #include <tuple>
 #include <type_traits>
+#include <unordered_map>
 #include <utility>
 #include <vector>
 
-using namespace std;
+#if defined(_WIN32)
+#include <io.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#endif
+
 namespace utils {
 
 template <typename T>
 concept PrintableElement = requires(T t) {
-  { cout << t } -> std::same_as<std::ostream &>;
+  { std::cout << t } -> std::same_as<std::ostream &>;
 }
 &&!std::is_enum_v<T>;
 
 template <typename T>
 concept ContainerWithPrintableElement = requires(T c) {
   {c.begin()};
-  { cout << (*(c.begin())) } -> std::same_as<std::ostream &>;
+  { std::cout << (*(c.begin())) } -> std::same_as<std::ostream &>;
   {c.end()};
 }
 &&!PrintableElement<T>;
@@ -36,7 +76,7 @@ concept ContainerWithPrintableElement = requires(T c) {
 template <typename T>
 concept NestedContainerWithPrintableElement = requires(T c) {
   {c.begin()};
-  { cout << (*((*(c.begin())).begin())) } -> std::same_as<std::ostream &>;
+  { std::cout << (*((*(c.begin())).begin())) } -> std::same_as<std::ostream &>;
   {c.end()};
 }
 &&!PrintableElement<T> && !ContainerWithPrintableElement<T>;
@@ -45,46 +85,287 @@ template <typename T>
 concept AnyInput = PrintableElement<T> || ContainerWithPrintableElement<T> ||
     NestedContainerWithPrintableElement<T>;
 
-template <PrintableElement... Args> void Print(Args... args) {
-  ((cout << std::setprecision(20) << args << " "), ...) << "";
+// output sinks for print_to/println_to besides std::ostream&, FILE* and
+// std::string&: a raw file descriptor, e.g. utils::fd_sink{2}
+struct fd_sink {
+  int fd;
+};
+
+template <typename T>
+concept OutputSink = std::same_as<std::remove_cvref_t<T>, fd_sink> ||
+    std::convertible_to<T, std::FILE *> ||
+    std::same_as<std::remove_cvref_t<T>, std::string> ||
+    std::derived_from<std::remove_cvref_t<T>, std::ostream>;
+
+template <typename C> struct summary;
+template <typename T, std::size_t Rank> class tensor_view;
+template <typename T, std::size_t Rank> class tensor;
+template <typename T> class range_view;
+template <typename T> class generator;
+
+namespace detail {
+template <typename T> struct is_tensor : std::false_type {};
+template <typename T, std::size_t Rank>
+struct is_tensor<tensor_view<T, Rank>> : std::true_type {};
+template <typename T, std::size_t Rank>
+struct is_tensor<tensor<T, Rank>> : std::true_type {};
+
+template <typename T> struct is_range_view : std::false_type {};
+template <typename T> struct is_range_view<range_view<T>> : std::true_type {};
+
+template <typename T> struct is_generator : std::false_type {};
+template <typename T> struct is_generator<generator<T>> : std::true_type {};
+} // namespace detail
+
+// utils::tensor or utils::tensor_view, cv/ref qualified
+template <typename T>
+concept Tensor = detail::is_tensor<std::remove_cvref_t<T>>::value;
+
+// utils::range_view, the lazy result of utils::range
+template <typename T>
+concept RangeView = detail::is_range_view<std::remove_cvref_t<T>>::value;
+
+// utils::generator, a coroutine stream
+template <typename T>
+concept Generator = detail::is_generator<std::remove_cvref_t<T>>::value;
+
+namespace detail {
+inline void write_to(std::ostream &os, std::string_view s) {
+  os.write(s.data(), static_cast<std::streamsize>(s.size()));
 }
 
-inline void Println() { cout << "\n"; }
+inline void write_to(std::FILE *file, std::string_view s) {
+  std::fwrite(s.data(), 1, s.size(), file);
+}
 
-// print all element in a container
-void Print(ContainerWithPrintableElement auto c) {
-  Print("[");
-  for (const auto &val : c) {
-    Print(val);
+inline void write_to(std::string &out, std::string_view s) { out.append(s); }
+
+inline void write_to(fd_sink sink, std::string_view s) {
+  while (!s.empty()) {
+#if defined(_WIN32)
+    auto written =
+        ::_write(sink.fd, s.data(), static_cast<unsigned int>(s.size()));
+#else
+    auto written = ::write(sink.fd, s.data(), s.size());
+#endif
+    if (written < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return;
+    }
+    s.remove_prefix(static_cast<std::size_t>(written));
   }
-  Print("]");
 }
 
-// print all element in a nested container
-void Print(NestedContainerWithPrintableElement auto c) {
-  if (c.size() == 0) {
-    Print("[]");
-    return;
-  } else {
-    Print("[");
-    for (const auto &sc : c) {
-      Print(sc);
-      Print(",");
+template <typename T>
+concept StringLike = std::convertible_to<const T &, std::string_view>;
+
+template <typename T>
+concept CharLike = std::same_as<T, char> || std::same_as<T, signed char> ||
+    std::same_as<T, unsigned char>;
+
+template <typename T> struct is_summary : std::false_type {};
+template <typename C> struct is_summary<summary<C>> : std::true_type {};
+
+/*
+formatter appends text to a thread local buffer that keeps its capacity
+between calls and hands it to the sink in large batches. numbers go through
+std::to_chars (shortest round-trip representation for floating point).
+*/
+template <typename Sink> class formatter {
+public:
+  static constexpr std::size_t flush_threshold = 1 << 16;
+
+  explicit formatter(Sink &sink) : _sink(sink), _buffer(acquire()) {}
+  formatter(const formatter &) = delete;
+  formatter &operator=(const formatter &) = delete;
+  ~formatter() {
+    flush();
+    release();
+  }
+
+  void put(std::string_view s) {
+    _buffer.append(s);
+    if (_buffer.size() >= flush_threshold) {
+      flush();
+    }
+  }
+
+  void put(char c) {
+    _buffer.push_back(c);
+    if (_buffer.size() >= flush_threshold) {
+      flush();
+    }
+  }
+
+  template <typename T> void value(const T &val) {
+    if constexpr (is_summary<T>::value) {
+      std::size_t saved = _edge_items;
+      _edge_items = val.edge_items;
+      value(val.container);
+      _edge_items = saved;
+    } else if constexpr (StringLike<T>) {
+      put(std::string_view(val));
+    } else if constexpr (std::same_as<T, bool>) {
+      put(val ? '1' : '0');
+    } else if constexpr (CharLike<T>) {
+      put(static_cast<char>(val));
+    } else if constexpr (std::is_arithmetic_v<T>) {
+      char digits[64];
+      auto [end, ec] = std::to_chars(digits, digits + sizeof(digits), val);
+      put(std::string_view(digits, static_cast<std::size_t>(end - digits)));
+    } else if constexpr (Tensor<T>) {
+      // 多维按行嵌套输出,和嵌套vector的格式一致
+      if constexpr (T::rank() > 1) {
+        elements(val.rows());
+      } else {
+        elements(val);
+      }
+    } else if constexpr (std::ranges::input_range<const T>) {
+      elements(val);
+    } else {
+      std::ostringstream os;
+      os << val;
+      put(os.str());
+    }
+  }
+
+  void flush() {
+    if (!_buffer.empty()) {
+      write_to(_sink, _buffer);
+      _buffer.clear();
     }
-    cout << "\x08\x08"; // backspace
-    Print("]");
   }
+
+private:
+  // [a, b, c], inside a summary only the first and last _edge_items elements
+  // of a longer range are written: [a, b, ..., y, z]
+  template <typename R> void elements(const R &r) {
+    put('[');
+    std::size_t n = 0;
+    std::size_t skip_from = static_cast<std::size_t>(-1);
+    std::size_t skip_to = 0;
+    if constexpr (std::ranges::sized_range<const R> &&
+                  std::ranges::forward_range<const R>) {
+      std::size_t size = std::ranges::size(r);
+      if (_edge_items > 0 && size > 2 * _edge_items) {
+        skip_from = _edge_items;
+        skip_to = size - _edge_items;
+      }
+    }
+    auto it = std::ranges::begin(r);
+    auto last = std::ranges::end(r);
+    for (; it != last; ++it, ++n) {
+      if (n > 0) {
+        put(", ");
+      }
+      if (n == skip_from) {
+        put("...");
+        std::ranges::advance(it, static_cast<std::ptrdiff_t>(skip_to - n - 1));
+        n = skip_to - 1;
+        continue;
+      }
+      value(*it);
+    }
+    put(']');
+  }
+
+  // the buffer is shared by all formatters of a thread, a nested formatter
+  // (e.g. a custom operator<< that prints) gets a private one
+  std::string &acquire() {
+    if (_buffer_in_use) {
+      _nested = true;
+      return _private;
+    }
+    _buffer_in_use = true;
+    _shared.clear();
+    return _shared;
+  }
+
+  void release() {
+    if (!_nested) {
+      _buffer_in_use = false;
+    }
+  }
+
+  static inline thread_local std::string _shared;
+  static inline thread_local bool _buffer_in_use = false;
+
+  Sink &_sink;
+  std::string _private;
+  bool _nested = false;
+  std::string &_buffer;
+  std::size_t _edge_items = 0;
+};
+
+template <typename Sink, typename... T>
+void format_to(Sink &sink, bool newline, const T &...args) {
+  formatter<Sink> f(sink);
+  std::size_t index = 0;
+  ((index++ > 0 ? f.put(' ') : void(), f.value(args)), ...);
+  if (newline) {
+    f.put('\n');
+  }
+}
+
+template <typename Sink> decltype(auto) sink_ref(Sink &&sink) {
+  if constexpr (std::convertible_to<Sink, std::FILE *>) {
+    return static_cast<std::FILE *>(sink);
+  } else if constexpr (std::same_as<std::remove_cvref_t<Sink>, fd_sink>) {
+    return fd_sink(sink);
+  } else {
+    return std::forward<Sink>(sink);
+  }
+}
+} // namespace detail
+
+/*
+summary(c, n) prints like c but only shows the first and last n elements of
+a long container, e.g. utils::println(utils::summary(v, 3)) -> [0, 1, 2, ...,
+7, 8, 9]
+*/
+template <typename C> struct summary {
+  const C &container;
+  std::size_t edge_items = 3;
+
+  friend std::ostream &operator<<(std::ostream &os, const summary &s) {
+    detail::format_to(os, false, s);
+    return os;
+  }
+};
+
+template <typename C> summary(const C &, std::size_t) -> summary<C>;
+template <typename C> summary(const C &) -> summary<C>;
+
+template <AnyInput... T> void Print(const T &...args) {
+  detail::format_to(std::cout, false, args...);
 }
 
-// print anything element if it is printable
-inline void println() { cout << "\n"; }
+inline void Println() { std::cout << "\n"; }
+
+// print anything element if it is printable, containers are written as
+// [a, b, c] and arguments are separated by one space
+inline void println() { std::cout << "\n"; }
 
-template <AnyInput... T1> void print(T1... any_inputs) {
-  (Print(any_inputs), ...);
+template <AnyInput... T1> void print(const T1 &...any_inputs) {
+  detail::format_to(std::cout, false, any_inputs...);
 }
-template <AnyInput... T1> void println(T1... any_inputs) {
-  (Print(any_inputs), ...);
-  cout << "\n";
+template <AnyInput... T1> void println(const T1 &...any_inputs) {
+  detail::format_to(std::cout, true, any_inputs...);
+}
+
+// same as print/println, but write to a FILE*, std::ostream, std::string
+// (appended) or utils::fd_sink
+template <OutputSink Sink, AnyInput... T1>
+void print_to(Sink &&sink, const T1 &...any_inputs) {
+  decltype(auto) target = detail::sink_ref(std::forward<Sink>(sink));
+  detail::format_to(target, false, any_inputs...);
+}
+template <OutputSink Sink, AnyInput... T1>
+void println_to(Sink &&sink, const T1 &...any_inputs) {
+  decltype(auto) target = detail::sink_ref(std::forward<Sink>(sink));
+  detail::format_to(target, true, any_inputs...);
 }
 
 template <typename T>
@@ -93,16 +374,16 @@ concept Arithmetic = std::is_arithmetic_v<std::decay_t<T>>;
 template <typename T>
 concept ContainerWithArithmeticElement = requires(T c) {
   {*c.begin()};
-  {c.size()};
+  {c.end()};
 }
-&&Arithmetic<decltype(*(declval<T>().begin()))>;
+&&Arithmetic<decltype(*(std::declval<T>().begin()))>;
 
 template <typename T>
 concept NestedContainerWithArithmeticElement = requires(T c) {
   {*c.begin()};
-  {c.size()};
+  {c.end()};
 }
-&&ContainerWithArithmeticElement<decltype(*(declval<T>().begin()))>;
+&&ContainerWithArithmeticElement<decltype(*(std::declval<T>().begin()))>;
 
 template <typename T>
 concept Comparable = requires(T t1, T t2) {
@@ -114,462 +395,6129 @@ concept ContainerWithComparableElement = requires(T c) {
   {*c.begin()};
   {c.size()};
 }
-&&Comparable<decltype(*(declval<T>().begin()))>;
-
-template <ContainerWithArithmeticElement C>
-typename std::decay_t<decltype(*(declval<C>().begin()))> sum(C &&c) {
-  using return_type = typename std::decay_t<decltype(*(declval<C>().begin()))>;
-  return_type sumval = return_type(0);
-  for (const auto &val : c) {
-    sumval += val;
-  }
-  return sumval;
-}
+&&Comparable<decltype(*(std::declval<T>().begin()))>;
 
-template <NestedContainerWithArithmeticElement C>
-typename std::decay_t<
-    decltype(*(declval<decltype(*(declval<C>().begin()))>().begin()))>
-sum(C &&c) {
-  using return_type = typename std::decay_t<decltype(*(
-      declval<decltype(*(declval<C>().begin()))>().begin()))>;
-  return_type sumval = return_type(0);
-  for (const auto &sub_container : c) {
-    sumval += sum(sub_container);
-  }
-  return sumval;
-}
+/*
+instrumentation: compile with -DUTILS_INSTRUMENT=1 to record, per thread and
+without locks, how often sum/prod/minmax/map/select/fold/fold_assoc/
+fold_list/accumulate_list/equals/dot are called, how many elements and bytes
+they touch and a latency histogram.
+probe_snapshot() adds up all threads on demand, to_json() and
+probe_trace_json() (chrome://tracing, perfetto) export the data. calls made
+inside another probed call (chunks of a parallel sum, rows of a nested sum)
+count towards the outer call only. with UTILS_INSTRUMENT=0 (the default) the
+probes expand to nothing and no global state exists.
+*/
+#ifndef UTILS_INSTRUMENT
+#define UTILS_INSTRUMENT 0
+#endif
 
-template <ContainerWithArithmeticElement C>
-typename std::decay_t<decltype(*(declval<C>().begin()))> prod(C &&c) {
-  if (c.size() == 0) {
-    return 0;
-  }
-  using return_type = typename std::decay_t<decltype(*(declval<C>().begin()))>;
-  return_type prodval = return_type(1);
-  for (const auto &val : c) {
-    prodval *= val;
-  }
-  return prodval;
-}
+enum class probe : std::uint8_t {
+  sum,
+  prod,
+  minmax,
+  map,
+  select,
+  fold,
+  fold_assoc,
+  fold_list,
+  accumulate_list,
+  equals,
+  dot
+};
+inline constexpr std::size_t probe_count = 11;
+inline constexpr std::array<std::string_view, probe_count> probe_names{
+    "sum",        "prod",      "minmax",          "map",    "select", "fold",
+    "fold_assoc", "fold_list", "accumulate_list", "equals", "dot"};
 
-template <NestedContainerWithArithmeticElement C>
-typename std::decay_t<
-    decltype(*(declval<decltype(*(declval<C>().begin()))>().begin()))>
-prod(C &&c) {
-  using return_type = typename std::decay_t<decltype(*(
-      declval<decltype(*(declval<C>().begin()))>().begin()))>;
-  return_type prodval = return_type(1);
-  for (const auto &sub_container : c) {
-    prodval *= prod(sub_container);
-  }
-  return prodval;
-}
+struct probe_stats;
+inline std::vector<probe_stats> probe_snapshot();
 
-template <ContainerWithArithmeticElement C>
-std::decay_t<decltype(*std::declval<C>().begin())> numel(C &&c) {
-  if (c.size() == 0) {
-    return 0;
-  }
-  using return_type = std::decay_t<decltype(*std::declval<C>().begin())>;
-  return_type prodval = return_type{1};
-  for (const auto &val : c) {
-    prodval *= val;
-  }
-  return prodval;
-}
+/*
+latency_histogram: HDR style log-linear buckets, 16 per power of two, so a
+recorded value is known to within 1/16 (6.25%) from 1ns up to ~73 minutes.
+min and max are exact.
+*/
+class latency_histogram {
+public:
+  static constexpr std::size_t sub_buckets = 16;
+  static constexpr std::size_t max_exponent = 42;
+  static constexpr std::size_t buckets = (max_exponent - 3) * sub_buckets;
 
-template <NestedContainerWithArithmeticElement C>
-typename std::decay_t<decltype(*(*declval<C>().begin()).begin())> numel(C &&c) {
-  if (c.size() == 0) {
-    return 0;
+  static constexpr std::size_t bucket_of(std::uint64_t ns) {
+    if (ns < sub_buckets) {
+      return static_cast<std::size_t>(ns);
+    }
+    std::size_t msb = std::bit_width(ns) - 1;
+    if (msb >= max_exponent) {
+      return buckets - 1;
+    }
+    return (msb - 3) * sub_buckets + ((ns >> (msb - 4)) & (sub_buckets - 1));
   }
-  using return_type =
-      typename std::decay_t<decltype(*(*declval<C>().begin()).begin())>;
-  return_type result = return_type{0};
-  for (const auto &inner_container : c) {
-    result += numel(inner_container);
+  // smallest value that falls into bucket i
+  static constexpr std::uint64_t bucket_floor(std::size_t i) {
+    if (i < sub_buckets) {
+      return i;
+    }
+    std::size_t msb = i / sub_buckets + 3;
+    return (sub_buckets + i % sub_buckets) << (msb - 4);
   }
-  return result;
-}
 
-// map/transform
-template <typename F, typename C>
-requires requires(C c) {
-  {c.begin()};
-  {c.end()};
-} && std::invocable<F,
-                    typename std::decay_t<decltype(*std::declval<C>().begin())>>
-auto map(F &&f, C &&c) {
-  using InputType = typename std::decay_t<decltype(*c.begin())>;
-  using ResultType = std::decay_t<decltype(f(std::declval<InputType>()))>;
-  std::vector<ResultType> result;
-  result.reserve(c.size());
-  for (const auto &val : c) {
-    result.push_back(f(val));
+  void record(std::uint64_t ns, std::uint64_t times = 1) {
+    if (times == 0) {
+      return;
+    }
+    _counts[bucket_of(ns)] += times;
+    _min = _total == 0 ? ns : std::min(_min, ns);
+    _max = std::max(_max, ns);
+    _total += times;
   }
-  return result;
-}
-
-inline string shape_to_string(ContainerWithPrintableElement auto &&shape) {
-  std::stringstream ss;
-  ss << "[";
-  for (auto it = shape.begin(); it != shape.end(); it++) {
-    ss << (*it);
-    if (it + 1 != shape.end()) {
-      ss << ",";
+  void merge(const latency_histogram &other) {
+    if (other._total == 0) {
+      return;
+    }
+    for (std::size_t i = 0; i < buckets; ++i) {
+      _counts[i] += other._counts[i];
     }
+    _min = _total == 0 ? other._min : std::min(_min, other._min);
+    _max = std::max(_max, other._max);
+    _total += other._total;
   }
-  ss << "]";
-  return ss.str();
-}
 
-inline string
-shape_to_string(NestedContainerWithPrintableElement auto &&shape) {
-  std::stringstream ss;
-  ss << "[";
-  for (auto it = shape.begin(); it != shape.end(); it++) {
-    ss << "[";
-    for (auto sub_it = (*it).begin(); sub_it != (*it).end(); sub_it++) {
-      ss << (*sub_it);
-      if (sub_it + 1 != (*it).end()) {
-        ss << ",";
-      }
-      // else {
-      //   ss << "]";
-      // }
+  std::uint64_t count() const { return _total; }
+  std::uint64_t count(std::size_t bucket) const { return _counts[bucket]; }
+  std::uint64_t min() const { return _min; }
+  std::uint64_t max() const { return _max; }
+  // p in [0, 1], the middle of the bucket holding the p-th value
+  double percentile(double p) const {
+    if (_total == 0) {
+      return 0;
     }
-    ss << "]";
-    if (it + 1 != shape.end()) {
-      ss << ",";
+    auto rank = static_cast<std::uint64_t>(
+        std::ceil(std::clamp(p, 0.0, 1.0) * double(_total)));
+    std::uint64_t seen = 0;
+    for (std::size_t i = 0; i < buckets; ++i) {
+      seen += _counts[i];
+      if (seen >= std::max<std::uint64_t>(rank, 1)) {
+        double lo = double(bucket_floor(i));
+        double hi = i + 1 < buckets ? double(bucket_floor(i + 1)) : lo;
+        return std::clamp((lo + hi) / 2, double(_min), double(_max));
+      }
     }
+    return double(_max);
   }
-  ss << "]";
-  return ss.str();
-}
 
-auto max(const Comparable auto &a, const Comparable auto &b) {
-  return a < b ? b : a;
-}
+private:
+  friend std::vector<probe_stats> probe_snapshot();
 
-template <Comparable... Args>
-auto max(const Comparable auto &a, const Args &...args) {
-  return utils::max(a, utils::max(args...));
-}
+  std::array<std::uint64_t, buckets> _counts{};
+  std::uint64_t _total = 0;
+  std::uint64_t _min = 0;
+  std::uint64_t _max = 0;
+};
 
-template <template <typename, typename> class Container, typename T,
-          typename Allocator = std::allocator<T>>
-auto max(const Container<T, Allocator> &container) {
-  if (container.size() == 0) {
-    throw std::runtime_error(
-        std::string("container must contain at least one element!"));
+#if UTILS_INSTRUMENT
+namespace detail {
+// written only by the owning thread (load + store, no locked instructions),
+// read by probe_snapshot() from any thread
+struct probe_counters {
+  std::atomic<std::uint64_t> calls{0};
+  std::atomic<std::uint64_t> elements{0};
+  std::atomic<std::uint64_t> bytes{0};
+  std::atomic<std::uint64_t> total_ns{0};
+  std::atomic<std::uint64_t> min_ns{std::numeric_limits<std::uint64_t>::max()};
+  std::atomic<std::uint64_t> max_ns{0};
+  std::array<std::atomic<std::uint64_t>, latency_histogram::buckets> latency{};
+};
+
+struct trace_event {
+  std::uint64_t start_ns;
+  std::uint64_t duration_ns;
+  std::uint64_t elements;
+  probe id;
+};
+
+// the first trace_capacity calls per thread after tracing is switched on
+inline constexpr std::size_t trace_capacity = std::size_t(1) << 16;
+
+struct probe_slot {
+  std::array<probe_counters, probe_count> counters;
+  std::size_t thread_index = 0;
+  std::unique_ptr<trace_event[]> trace;
+  std::atomic<std::size_t> trace_size{0};
+};
+
+// slots are never freed, the numbers of finished threads stay in the totals
+struct probe_registry {
+  std::mutex mutex;
+  std::vector<std::unique_ptr<probe_slot>> slots;
+  std::atomic<bool> tracing{false};
+  std::chrono::steady_clock::time_point epoch =
+      std::chrono::steady_clock::now();
+
+  static probe_registry &instance() {
+    static probe_registry registry;
+    return registry;
   }
+};
 
-  return std::accumulate(container.begin(), container.end(), *container.begin(),
-                         [](auto a, auto b) { return utils::max(a, b); });
+inline probe_slot &this_thread_probe_slot() {
+  thread_local probe_slot *slot = [] {
+    auto &registry = probe_registry::instance();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    registry.slots.push_back(std::make_unique<probe_slot>());
+    registry.slots.back()->thread_index = registry.slots.size() - 1;
+    return registry.slots.back().get();
+  }();
+  return *slot;
 }
 
-auto min(const Comparable auto &a, const Comparable auto &b) {
-  return a < b ? a : b;
-}
+// > 0 while this thread runs inside a probed call
+inline thread_local std::size_t probe_depth = 0;
 
-template <Comparable... Args>
-auto min(const Comparable auto &a, const Args &...args) {
-  return utils::min(a, utils::min(args...));
+inline std::uint64_t probe_now() {
+  return static_cast<std::uint64_t>(
+      std::chrono::duration_cast<std::chrono::nanoseconds>(
+          std::chrono::steady_clock::now() -
+          probe_registry::instance().epoch)
+          .count());
 }
 
-template <template <typename, typename> class Container, typename T,
-          typename Allocator = std::allocator<T>>
-auto min(const Container<T, Allocator> &container) {
-  if (container.size() == 0) {
-    throw std::runtime_error(
-        std::string("container must contain at least one element!"));
-  }
-
-  return std::accumulate(container.begin(), container.end(), *container.begin(),
-                         [](auto a, auto b) { return utils::min(a, b); });
+inline void probe_add(std::atomic<std::uint64_t> &counter, std::uint64_t n) {
+  counter.store(counter.load(std::memory_order_relaxed) + n,
+                std::memory_order_relaxed);
 }
 
-template <typename Iterator1, typename Iterator2> class zipiterator {
-public:
-  zipiterator(Iterator1 it1_begin, Iterator1 it1_end, Iterator2 it2_begin,
-              Iterator2 it2_end)
-      : _it1(it1_begin), _it2(it2_begin), _it1_end(it1_end), _it2_end(it2_end) {
-    this->has_end_iter = true;
-  };
-  zipiterator(Iterator1 it1, Iterator2 it2) : _it1(it1), _it2(it2) {
-    this->has_end_iter = false;
-  };
-  using value_type = std::tuple<typename Iterator1::value_type,
-                                typename Iterator2::value_type>;
-  value_type operator*() { return value_type(*(this->_it1), *(this->_it2)); }
-  zipiterator &operator++() {
-    ++this->_it1;
-    ++this->_it2;
-    return *this;
+inline void probe_record(probe id, std::uint64_t start, std::uint64_t elements,
+                         std::uint64_t bytes) {
+  std::uint64_t ns = probe_now() - start;
+  auto &slot = this_thread_probe_slot();
+  auto &c = slot.counters[static_cast<std::size_t>(id)];
+  probe_add(c.calls, 1);
+  probe_add(c.elements, elements);
+  probe_add(c.bytes, bytes);
+  probe_add(c.total_ns, ns);
+  probe_add(c.latency[latency_histogram::bucket_of(ns)], 1);
+  if (ns < c.min_ns.load(std::memory_order_relaxed)) {
+    c.min_ns.store(ns, std::memory_order_relaxed);
   }
-
-  zipiterator operator++(int) {
-    zipiterator tmp = *this;
-    ++(*this); // 复用前置自增
-    return tmp;
+  if (ns > c.max_ns.load(std::memory_order_relaxed)) {
+    c.max_ns.store(ns, std::memory_order_relaxed);
   }
-
-  bool operator==(const zipiterator &other) const {
-    bool first_eq = (this->_it1 == other._it1);
-    bool second_eq = (this->_it2 == other._it2);
-    if (first_eq && second_eq) {
-      return true;
-    } else {
-      return false;
+  if (probe_registry::instance().tracing.load(std::memory_order_relaxed)) {
+    std::size_t n = slot.trace_size.load(std::memory_order_relaxed);
+    if (n < trace_capacity) {
+      if (!slot.trace) {
+        slot.trace = std::make_unique<trace_event[]>(trace_capacity);
+      }
+      slot.trace[n] = trace_event{start, ns, elements, id};
+      // publishes the event (and the buffer) to probe_trace_json()
+      slot.trace_size.store(n + 1, std::memory_order_release);
     }
   }
+}
 
-  bool operator!=(const zipiterator &other) const {
-    //        return this->_it1 != other._it1 || this->_it2 != other._it2;
-    // 判断是否迭代到末尾的条件,注意上面这种写法是错误的
-    // 因为要同时判断两个长度不一定相等的迭代器是否有某一个到达了末尾
-    // 逻辑应该是只要有一个到了末尾,另一个就直接停止迭代,因为再往下迭代会导致较短的一个迭代器崩溃
-    // 类似于python的zip语法
-    // 还要写一个警告条件,两个迭代器要么都等于end要么都不等于end
-    bool warning_cond =
-        ((this->has_end_iter) &&
-         (other
-              .has_end_iter)) && /*与自身进行比较的迭代器中要记住end迭代器，否则无法比较*/
-        (((this->_it1 == other._it1_end) &&
-          (this->_it2 !=
-           other._it2_end)) || /*第一个迭代器停止了，第二个还没停*/
-         ((this->_it1 != other._it1_end) &&
-          (this->_it2 == other._it2_end))); /*第二个迭代器停止了，第一个还没停*/
-    if (warning_cond) {
-      // println("warning:utils::zip length not match");
+// RAII probe placed by UTILS_PROBE, does nothing in constant evaluation
+class probe_scope {
+public:
+  template <typename C>
+  constexpr probe_scope(probe id, const C &c) : _id(id) {
+    if (std::is_constant_evaluated()) {
+      return;
+    }
+    if (probe_depth++ > 0) {
+      return;
+    }
+    _active = true;
+    using R = std::remove_cvref_t<C>;
+    // element counts are only known for flat sized inputs
+    if constexpr (std::ranges::sized_range<const R>) {
+      using T = std::ranges::range_value_t<const R>;
+      if constexpr (Arithmetic<T>) {
+        _elements = static_cast<std::uint64_t>(std::ranges::size(c));
+        _bytes = _elements * sizeof(T);
+      }
+    }
+    _start = probe_now();
+  }
+  constexpr ~probe_scope() {
+    if (std::is_constant_evaluated()) {
+      return;
+    }
+    --probe_depth;
+    if (_active) {
+      probe_record(_id, _start, _elements, _bytes);
     }
-
-    auto not_equal = !(this->_it1 == other._it1 || this->_it2 == other._it2);
-    return not_equal;
   }
+  probe_scope(const probe_scope &) = delete;
+  probe_scope &operator=(const probe_scope &) = delete;
 
-  Iterator1 _it1;
-  Iterator2 _it2;
-  Iterator1 _it1_end;
-  Iterator2 _it2_end;
-  bool has_end_iter;
-  //    uint32_t count;
+private:
+  probe _id;
+  bool _active = false;
+  std::uint64_t _start = 0;
+  std::uint64_t _elements = 0;
+  std::uint64_t _bytes = 0;
 };
 
-template <typename ContainerType1, typename ContainerType2> class zip {
-public:
-  using IteratorType = zipiterator<typename ContainerType1::iterator,
-                                   typename ContainerType2::iterator>;
-  using value_type = std::tuple<typename ContainerType1::iterator::value_type,
-                                typename ContainerType2::iterator::value_type>;
-  using iterator = IteratorType;
-  zip(const ContainerType1 &c1, const ContainerType2 &c2) : _c1(c1), _c2(c2) {
-    auto c1begin = c1.begin();
-    auto c1end = c1.end();
-    auto c2begin = c2.begin();
-    auto c2end = c2.end();
-    auto pp = IteratorType(this->_c1.end(), this->_c1.end(), this->_c2.end(),
-                           this->_c2.end());
-    utils::println(4554);
-  };
-  IteratorType begin() {
-    return IteratorType(this->_c1.begin(), this->_c1.end(), this->_c2.begin(),
-                        this->_c2.end());
-  }
+inline bool in_probe() { return probe_depth > 0; }
 
-  IteratorType end() {
-    auto t = IteratorType(this->_c1.end(), this->_c1.end(), this->_c2.end(),
-                          this->_c2.end());
-    return t;
+// work a thread pool runs on behalf of a probed call is part of that call
+class probe_nesting {
+public:
+  explicit probe_nesting(bool nested) : _nested(nested) {
+    probe_depth += _nested;
   }
+  ~probe_nesting() { probe_depth -= _nested; }
+  probe_nesting(const probe_nesting &) = delete;
+  probe_nesting &operator=(const probe_nesting &) = delete;
 
-  size_t size() { return utils::min(this->_c1.size(), this->_c2.size()); }
-
-  ContainerType1 _c1;
-  ContainerType2 _c2;
+private:
+  bool _nested;
 };
+} // namespace detail
 
-template <typename T> struct enumerate_iterator {
-public:
-  enumerate_iterator(uint64_t initial_count, typename T::iterator it)
-      : count(initial_count), _it(it){
-                                  // utils::println("paused");
-                              };
-  using value_type = std::tuple<uint64_t, typename T::value_type>;
-  value_type operator*() { return value_type{this->count, *(this->_it)}; }
-  enumerate_iterator &operator++() {
-    ++this->count;
-    ++this->_it;
-    return *this;
-  }
-  bool operator==(enumerate_iterator &other) {
-    return !(this->_it != other._it);
-  }
-  bool operator!=(enumerate_iterator &other) {
-    return !this->operator==(other);
-  }
-  uint64_t count;
-  typename T::iterator _it;
+#define UTILS_PROBE(id, c)                                                     \
+  ::utils::detail::probe_scope utils_probe_scope_(::utils::probe::id, c)
+#else
+namespace detail {
+constexpr bool in_probe() { return false; }
+struct probe_nesting {
+  constexpr explicit probe_nesting(bool) {}
 };
+} // namespace detail
 
-template <typename T> struct enumerate {
-public:
-  using iterator = enumerate_iterator<T>;
-  using value_type = typename enumerate_iterator<T>::value_type;
-  enumerate(const T &c) : _c(c){};
-  enumerate(T &&c) : _c(std::move(c)){};
-  iterator begin() { return iterator{this->count, this->_c.begin()}; }
-  iterator end() {
-    return iterator{
-        this->_c.size(),
-        this->_c.end()};
-  }
-  T _c;
-  uint64_t count = 0;
-};
+#define UTILS_PROBE(id, c)
+#endif
 
-template <std::size_t... Is>
+#if defined(__GNUC__)
+#define UTILS_ALWAYS_INLINE __attribute__((always_inline)) inline
+#else
+#define UTILS_ALWAYS_INLINE inline
+#endif
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define UTILS_X86_DISPATCH 1
+#else
+#define UTILS_X86_DISPATCH 0
+#endif
+
+// opt-in accuracy modes for floating point reductions, e.g.
+// utils::sum(utils::kahan, v) or utils::sum(utils::pairwise, v)
+struct kahan_t {
+  explicit kahan_t() = default;
+};
+inline constexpr kahan_t kahan{};
+
+struct pairwise_t {
+  explicit pairwise_t() = default;
+};
+inline constexpr pairwise_t pairwise{};
+
+namespace detail {
+// element types that map onto SIMD lanes
+template <typename T>
+concept SimdArithmetic =
+    (std::is_integral_v<T> && !std::is_same_v<T, bool> && sizeof(T) <= 8) ||
+    std::is_same_v<T, float> || std::is_same_v<T, double>;
+
+template <typename C>
+concept ContiguousSimdRange =
+    std::ranges::contiguous_range<C> && std::ranges::sized_range<C> &&
+    SimdArithmetic<std::ranges::range_value_t<C>>;
+
+// sources bigger than memory (utils::streamed_array) hand out their values as
+// a sequence of contiguous chunks
+template <typename C>
+concept ChunkedSource = requires(C &c) {
+  c.for_each_chunk([](std::span<const std::ranges::range_value_t<C>>) {});
+};
+
+enum class simd_level { scalar, sse2, avx2, avx512 };
+
+// 运行时检测一次CPU支持的指令集,之后直接返回缓存结果
+inline simd_level detect_simd_level() {
+#if UTILS_X86_DISPATCH
+  static const simd_level level = [] {
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f")) {
+      return simd_level::avx512;
+    }
+    if (__builtin_cpu_supports("avx2")) {
+      return simd_level::avx2;
+    }
+    return simd_level::sse2;
+  }();
+  return level;
+#else
+  return simd_level::scalar;
+#endif
+}
+
+enum class reduce_op { sum, prod, kahan };
+
+template <typename T>
+UTILS_ALWAYS_INLINE void kahan_add(T &sum, T &c, const T &x) {
+  T y = x - c;
+  T t = sum + y;
+  c = (t - sum) - y;
+  sum = t;
+}
+
+template <reduce_op Op, typename T>
+UTILS_ALWAYS_INLINE void reduce_step(T &acc, T &comp, const T &x) {
+  if constexpr (Op == reduce_op::sum) {
+    acc += x;
+  } else if constexpr (Op == reduce_op::prod) {
+    acc *= x;
+  } else {
+    kahan_add(acc, comp, x);
+  }
+}
+
+/*
+reduce data[0..n) with `unroll` independent accumulators of `Bytes` wide
+vectors. the accumulators break the loop-carried dependency so the adds/muls
+of consecutive blocks can be pipelined. kahan keeps one compensation term per
+lane. note that kahan is defeated by -ffast-math.
+*/
+template <reduce_op Op, typename T, std::size_t Bytes>
+UTILS_ALWAYS_INLINE T reduce_kernel(const T *data, std::size_t n) {
+  constexpr T identity = Op == reduce_op::prod ? T(1) : T(0);
+  constexpr std::size_t unroll = 4;
+#if defined(__GNUC__)
+  typedef T vec __attribute__((vector_size(Bytes)));
+  constexpr std::size_t lanes = Bytes / sizeof(T);
+  vec acc[unroll];
+  vec comp[unroll];
+  for (std::size_t u = 0; u < unroll; ++u) {
+    acc[u] = vec{} + identity;
+    comp[u] = vec{};
+  }
+  std::size_t i = 0;
+  for (; i + unroll * lanes <= n; i += unroll * lanes) {
+    for (std::size_t u = 0; u < unroll; ++u) {
+      vec x;
+      std::memcpy(&x, data + i + u * lanes, Bytes);
+      reduce_step<Op>(acc[u], comp[u], x);
+    }
+  }
+  T result = identity;
+  T c = T(0);
+  for (std::size_t u = 0; u < unroll; ++u) {
+    for (std::size_t j = 0; j < lanes; ++j) {
+      reduce_step<Op>(result, c, acc[u][j]);
+      if constexpr (Op == reduce_op::kahan) {
+        kahan_add(result, c, T(-comp[u][j]));
+      }
+    }
+  }
+#else
+  T acc[unroll * 2];
+  T comp[unroll * 2];
+  for (std::size_t u = 0; u < unroll * 2; ++u) {
+    acc[u] = identity;
+    comp[u] = T(0);
+  }
+  std::size_t i = 0;
+  for (; i + unroll * 2 <= n; i += unroll * 2) {
+    for (std::size_t u = 0; u < unroll * 2; ++u) {
+      reduce_step<Op>(acc[u], comp[u], data[i + u]);
+    }
+  }
+  T result = identity;
+  T c = T(0);
+  for (std::size_t u = 0; u < unroll * 2; ++u) {
+    reduce_step<Op>(result, c, acc[u]);
+    if constexpr (Op == reduce_op::kahan) {
+      kahan_add(result, c, T(-comp[u]));
+    }
+  }
+#endif
+  for (; i < n; ++i) {
+    reduce_step<Op>(result, c, data[i]);
+  }
+  return Op == reduce_op::kahan ? T(result - c) : result;
+}
+
+#if UTILS_X86_DISPATCH
+template <reduce_op Op, typename T>
+__attribute__((target("avx2"))) T reduce_avx2(const T *data, std::size_t n) {
+  return reduce_kernel<Op, T, 32>(data, n);
+}
+
+template <reduce_op Op, typename T>
+__attribute__((target("avx512f"))) T reduce_avx512(const T *data,
+                                                   std::size_t n) {
+  return reduce_kernel<Op, T, 64>(data, n);
+}
+#endif
+
+template <reduce_op Op, typename T>
+T reduce_contiguous(const T *data, std::size_t n) {
+#if UTILS_X86_DISPATCH
+  switch (detect_simd_level()) {
+  case simd_level::avx512:
+    return reduce_avx512<Op>(data, n);
+  case simd_level::avx2:
+    return reduce_avx2<Op>(data, n);
+  default:
+    break;
+  }
+#endif
+  return reduce_kernel<Op, T, 16>(data, n);
+}
+
+// 递归二分求和,每个叶子块用SIMD kernel,误差随log(n)增长
+template <typename T> T pairwise_reduce(const T *data, std::size_t n) {
+  constexpr std::size_t block = 1024;
+  if (n <= block) {
+    return reduce_contiguous<reduce_op::sum>(data, n);
+  }
+  std::size_t half = (n / 2 + block - 1) / block * block;
+  return pairwise_reduce(data, half) + pairwise_reduce(data + half, n - half);
+}
+} // namespace detail
+
+template <ContainerWithArithmeticElement C>
+constexpr typename std::decay_t<decltype(*(std::declval<C>().begin()))>
+sum(C &&c) {
+  UTILS_PROBE(sum, c);
+  using return_type = typename std::decay_t<decltype(*(std::declval<C>().begin()))>;
+  if constexpr (RangeView<C>) {
+    // arithmetic progression, closed form
+    return c.sum();
+  } else if constexpr (detail::ContiguousSimdRange<C>) {
+    // the SIMD kernels can not run in constant evaluation, use the loop below
+    if (!std::is_constant_evaluated()) {
+      return detail::reduce_contiguous<detail::reduce_op::sum>(
+          std::ranges::data(c), std::ranges::size(c));
+    }
+  } else if constexpr (detail::ChunkedSource<C>) {
+    return_type sumval = return_type(0);
+    c.for_each_chunk([&](auto chunk) { sumval += sum(chunk); });
+    return sumval;
+  }
+  return_type sumval = return_type(0);
+  for (const auto &val : c) {
+    sumval += val;
+  }
+  return sumval;
+}
+
+template <NestedContainerWithArithmeticElement C>
+typename std::decay_t<
+    decltype(*(std::declval<decltype(*(std::declval<C>().begin()))>().begin()))>
+    constexpr sum(C &&c) {
+  UTILS_PROBE(sum, c);
+  using return_type = typename std::decay_t<decltype(*(
+      std::declval<decltype(*(std::declval<C>().begin()))>().begin()))>;
+  return_type sumval = return_type(0);
+  for (const auto &sub_container : c) {
+    sumval += sum(sub_container);
+  }
+  return sumval;
+}
+
+// compensated (kahan) summation, only differs from sum(c) for floating point
+template <ContainerWithArithmeticElement C>
+typename std::decay_t<decltype(*(std::declval<C>().begin()))> sum(kahan_t, C &&c) {
+  UTILS_PROBE(sum, c);
+  using return_type = typename std::decay_t<decltype(*(std::declval<C>().begin()))>;
+  if constexpr (!std::is_floating_point_v<return_type>) {
+    return sum(std::forward<C>(c));
+  } else if constexpr (detail::ContiguousSimdRange<C>) {
+    return detail::reduce_contiguous<detail::reduce_op::kahan>(
+        std::ranges::data(c), std::ranges::size(c));
+  } else {
+    return_type sumval = return_type(0);
+    return_type comp = return_type(0);
+    for (const auto &val : c) {
+      detail::kahan_add(sumval, comp, static_cast<return_type>(val));
+    }
+    return sumval - comp;
+  }
+}
+
+template <NestedContainerWithArithmeticElement C>
+typename std::decay_t<
+    decltype(*(std::declval<decltype(*(std::declval<C>().begin()))>().begin()))>
+sum(kahan_t, C &&c) {
+  UTILS_PROBE(sum, c);
+  using return_type = typename std::decay_t<decltype(*(
+      std::declval<decltype(*(std::declval<C>().begin()))>().begin()))>;
+  return_type sumval = return_type(0);
+  return_type comp = return_type(0);
+  for (const auto &sub_container : c) {
+    detail::kahan_add(sumval, comp, sum(kahan, sub_container));
+  }
+  return sumval - comp;
+}
+
+// pairwise summation, non-contiguous ranges fall back to kahan summation
+template <ContainerWithArithmeticElement C>
+typename std::decay_t<decltype(*(std::declval<C>().begin()))> sum(pairwise_t,
+                                                             C &&c) {
+  UTILS_PROBE(sum, c);
+  if constexpr (detail::ContiguousSimdRange<C>) {
+    return detail::pairwise_reduce(std::ranges::data(c), std::ranges::size(c));
+  } else {
+    return sum(kahan, std::forward<C>(c));
+  }
+}
+
+template <NestedContainerWithArithmeticElement C>
+typename std::decay_t<
+    decltype(*(std::declval<decltype(*(std::declval<C>().begin()))>().begin()))>
+sum(pairwise_t, C &&c) {
+  UTILS_PROBE(sum, c);
+  using return_type = typename std::decay_t<decltype(*(
+      std::declval<decltype(*(std::declval<C>().begin()))>().begin()))>;
+  return_type sumval = return_type(0);
+  return_type comp = return_type(0);
+  for (const auto &sub_container : c) {
+    detail::kahan_add(sumval, comp, sum(pairwise, sub_container));
+  }
+  return sumval - comp;
+}
+
+template <ContainerWithArithmeticElement C>
+constexpr typename std::decay_t<decltype(*(std::declval<C>().begin()))>
+prod(C &&c) {
+  UTILS_PROBE(prod, c);
+  using return_type = typename std::decay_t<decltype(*(std::declval<C>().begin()))>;
+  if constexpr (detail::ContiguousSimdRange<C>) {
+    if (!std::is_constant_evaluated()) {
+      if (std::ranges::size(c) == 0) {
+        return 0;
+      }
+      return detail::reduce_contiguous<detail::reduce_op::prod>(
+          std::ranges::data(c), std::ranges::size(c));
+    }
+  } else if constexpr (detail::ChunkedSource<C>) {
+    return_type prodval = return_type(1);
+    bool empty = true;
+    c.for_each_chunk([&](auto chunk) {
+      prodval *= prod(chunk);
+      empty = false;
+    });
+    return empty ? return_type(0) : prodval;
+  }
+  // the product of an empty container is 0, like the sized version
+  return_type prodval = return_type(1);
+  bool empty = true;
+  for (const auto &val : c) {
+    prodval *= val;
+    empty = false;
+  }
+  return empty ? return_type(0) : prodval;
+}
+
+template <NestedContainerWithArithmeticElement C>
+typename std::decay_t<
+    decltype(*(std::declval<decltype(*(std::declval<C>().begin()))>().begin()))>
+    constexpr prod(C &&c) {
+  UTILS_PROBE(prod, c);
+  using return_type = typename std::decay_t<decltype(*(
+      std::declval<decltype(*(std::declval<C>().begin()))>().begin()))>;
+  return_type prodval = return_type(1);
+  for (const auto &sub_container : c) {
+    prodval *= prod(sub_container);
+  }
+  return prodval;
+}
+
+template <ContainerWithArithmeticElement C>
+constexpr std::decay_t<decltype(*std::declval<C>().begin())> numel(C &&c) {
+  using return_type = std::decay_t<decltype(*std::declval<C>().begin())>;
+  if constexpr (detail::ContiguousSimdRange<C>) {
+    if (!std::is_constant_evaluated()) {
+      if (std::ranges::size(c) == 0) {
+        return 0;
+      }
+      return detail::reduce_contiguous<detail::reduce_op::prod>(
+          std::ranges::data(c), std::ranges::size(c));
+    }
+  }
+  // the product of an empty container is 0, like the sized version
+  return_type prodval = return_type{1};
+  bool empty = true;
+  for (const auto &val : c) {
+    prodval *= val;
+    empty = false;
+  }
+  return empty ? return_type(0) : prodval;
+}
+
+template <NestedContainerWithArithmeticElement C>
+constexpr typename std::decay_t<decltype(*(*std::declval<C>().begin()).begin())>
+numel(C &&c) {
+  using return_type =
+      typename std::decay_t<decltype(*(*std::declval<C>().begin()).begin())>;
+  return_type result = return_type{0};
+  for (const auto &inner_container : c) {
+    result += numel(inner_container);
+  }
+  return result;
+}
+
+/*
+thread_pool: a fixed set of workers, each owning a task deque. a worker pops
+its own deque from the back and steals from the front of the others when it
+runs dry. parallel_for() blocks until every index is done and the calling
+thread helps with the work while waiting, so nested calls do not deadlock.
+*/
+class thread_pool {
+public:
+  explicit thread_pool(std::size_t threads = std::max<std::size_t>(
+                           1, std::thread::hardware_concurrency()))
+      : _queues(std::max<std::size_t>(1, threads)) {
+    for (std::size_t i = 0; i < _queues.size(); ++i) {
+      _workers.emplace_back([this, i] { this->worker_loop(i); });
+    }
+  }
+
+  thread_pool(const thread_pool &) = delete;
+  thread_pool &operator=(const thread_pool &) = delete;
+
+  ~thread_pool() {
+    {
+      std::lock_guard<std::mutex> lock(_mutex);
+      _stop = true;
+    }
+    _cv.notify_all();
+    for (auto &worker : _workers) {
+      worker.join();
+    }
+  }
+
+  std::size_t size() const { return _workers.size(); }
+
+  // process wide pool used by utils::par
+  static thread_pool &global() {
+    static thread_pool pool;
+    return pool;
+  }
+
+  template <typename F> void submit(F &&task) {
+    std::size_t i =
+        _next.fetch_add(1, std::memory_order_relaxed) % _queues.size();
+    // count the task before it is visible: a worker or a helping caller may
+    // pop it right away and decrement _pending, which must not wrap below 0
+    {
+      std::lock_guard<std::mutex> lock(_mutex);
+      ++_pending;
+    }
+    try {
+      std::lock_guard<std::mutex> lock(_queues[i].mutex);
+      _queues[i].tasks.emplace_back(std::forward<F>(task));
+    } catch (...) {
+      std::lock_guard<std::mutex> lock(_mutex);
+      --_pending;
+      throw;
+    }
+    _cv.notify_one();
+  }
+
+  // run fn(0) ... fn(n-1), rethrows the first exception thrown by fn
+  template <typename F> void parallel_for(std::size_t n, F &&fn) {
+    if (n <= 1) {
+      for (std::size_t i = 0; i < n; ++i) {
+        fn(i);
+      }
+      return;
+    }
+    struct context {
+      F &fn;
+      std::atomic<std::size_t> remaining;
+      std::mutex error_mutex;
+      std::exception_ptr error;
+    } ctx{fn, n, {}, nullptr};
+    bool in_probe = detail::in_probe();
+    for (std::size_t i = 0; i < n; ++i) {
+      submit([c = &ctx, i, in_probe] {
+        detail::probe_nesting nesting(in_probe);
+        try {
+          c->fn(i);
+        } catch (...) {
+          std::lock_guard<std::mutex> lock(c->error_mutex);
+          if (!c->error) {
+            c->error = std::current_exception();
+          }
+        }
+        c->remaining.fetch_sub(1, std::memory_order_acq_rel);
+      });
+    }
+    std::size_t self = current_worker();
+    while (ctx.remaining.load(std::memory_order_acquire) != 0) {
+      std::function<void()> task;
+      if (try_pop(self == npos ? 0 : self, task)) {
+        task();
+      } else {
+        std::this_thread::yield();
+      }
+    }
+    if (ctx.error) {
+      std::rethrow_exception(ctx.error);
+    }
+  }
+
+private:
+  static constexpr std::size_t npos = static_cast<std::size_t>(-1);
+
+  struct worker_queue {
+    std::mutex mutex;
+    std::deque<std::function<void()>> tasks;
+  };
+
+  std::size_t current_worker() const {
+    return _current_pool == this ? _current_index : npos;
+  }
+
+  bool try_pop(std::size_t self, std::function<void()> &task) {
+    for (std::size_t k = 0; k < _queues.size(); ++k) {
+      auto &queue = _queues[(self + k) % _queues.size()];
+      std::lock_guard<std::mutex> lock(queue.mutex);
+      if (queue.tasks.empty()) {
+        continue;
+      }
+      // 自己的队列从尾部取(LIFO, cache更热),其他队列从头部偷
+      if (k == 0) {
+        task = std::move(queue.tasks.back());
+        queue.tasks.pop_back();
+      } else {
+        task = std::move(queue.tasks.front());
+        queue.tasks.pop_front();
+      }
+      std::lock_guard<std::mutex> pending_lock(_mutex);
+      --_pending;
+      return true;
+    }
+    return false;
+  }
+
+  void worker_loop(std::size_t index) {
+    _current_pool = this;
+    _current_index = index;
+    while (true) {
+      std::function<void()> task;
+      if (try_pop(index, task)) {
+        task();
+        continue;
+      }
+      std::unique_lock<std::mutex> lock(_mutex);
+      _cv.wait(lock, [this] { return _stop || _pending > 0; });
+      if (_stop && _pending == 0) {
+        return;
+      }
+    }
+  }
+
+  static inline thread_local const thread_pool *_current_pool = nullptr;
+  static inline thread_local std::size_t _current_index = 0;
+
+  std::vector<worker_queue> _queues;
+  std::vector<std::thread> _workers;
+  std::atomic<std::size_t> _next{0};
+  std::mutex _mutex;
+  std::condition_variable _cv;
+  std::size_t _pending = 0;
+  bool _stop = false;
+};
+
+// execution policy tag, e.g. utils::map(utils::par, f, c) runs on
+// thread_pool::global(). a thread_pool can be passed in place of the tag.
+struct par_t {
+  explicit par_t() = default;
+};
+inline constexpr par_t par{};
+
+template <typename T>
+concept ExecutionPolicy = std::same_as<std::remove_cvref_t<T>, par_t> ||
+    std::same_as<std::remove_cvref_t<T>, thread_pool>;
+
+namespace detail {
+inline thread_pool &pool_of(par_t) { return thread_pool::global(); }
+inline thread_pool &pool_of(thread_pool &pool) { return pool; }
+
+template <typename C>
+concept ParallelInput =
+    std::ranges::random_access_range<C> && std::ranges::sized_range<C>;
+
+// elements per chunk so that one chunk of input fits in L2
+template <typename T>
+inline constexpr std::size_t cache_chunk =
+    std::max<std::size_t>(1024, (256 * 1024) / sizeof(T));
+
+// chunking for element-wise work (map/select): a few chunks per thread, a
+// multiple of 64 so that std::vector<bool> results never share a word
+template <typename T>
+std::size_t elementwise_chunk(std::size_t n, std::size_t threads) {
+  std::size_t chunk = std::clamp<std::size_t>(n / (threads * 8), 64,
+                                              cache_chunk<T>);
+  return (chunk + 63) / 64 * 64;
+}
+
+/*
+reduce fixed size chunks in parallel, then combine the partial results with
+a pairwise tree in chunk order. the chunk size only depends on the element
+type, so the result is bit-identical for any number of threads.
+*/
+template <typename C, typename ChunkReduce, typename Combine>
+auto parallel_reduce(thread_pool &pool, C &&c, ChunkReduce &&reduce_chunk,
+                     Combine &&combine) {
+  using T = std::ranges::range_value_t<C>;
+  std::size_t n = std::ranges::size(c);
+  std::size_t chunk = cache_chunk<T>;
+  std::size_t chunks = (n + chunk - 1) / chunk;
+  auto first = std::ranges::begin(c);
+  using R = decltype(reduce_chunk(std::ranges::subrange(first, first)));
+  // optional so that results without a default constructor work as well
+  std::vector<std::optional<R>> partials(chunks);
+  pool.parallel_for(chunks, [&](std::size_t i) {
+    auto lo = first + static_cast<std::ptrdiff_t>(i * chunk);
+    auto hi = first + static_cast<std::ptrdiff_t>(std::min(n, (i + 1) * chunk));
+    partials[i].emplace(reduce_chunk(std::ranges::subrange(lo, hi)));
+  });
+  for (std::size_t width = 1; width < chunks; width *= 2) {
+    for (std::size_t i = 0; i + width < chunks; i += 2 * width) {
+      partials[i].emplace(combine(std::move(*partials[i]),
+                                  std::move(*partials[i + width])));
+    }
+  }
+  return std::move(*partials[0]);
+}
+} // namespace detail
+
+template <ExecutionPolicy P, ContainerWithArithmeticElement C>
+requires detail::ParallelInput<C>
+typename std::decay_t<decltype(*(std::declval<C>().begin()))> sum(P &&policy,
+                                                             C &&c) {
+  UTILS_PROBE(sum, c);
+  using return_type = typename std::decay_t<decltype(*(std::declval<C>().begin()))>;
+  if (RangeView<C> ||
+      std::ranges::size(c) <= detail::cache_chunk<return_type>) {
+    return sum(std::forward<C>(c));
+  }
+  return detail::parallel_reduce(
+      detail::pool_of(policy), c, [](auto chunk) { return sum(chunk); },
+      [](return_type a, return_type b) { return a + b; });
+}
+
+template <ExecutionPolicy P, ContainerWithArithmeticElement C>
+requires detail::ParallelInput<C>
+typename std::decay_t<decltype(*(std::declval<C>().begin()))> prod(P &&policy,
+                                                              C &&c) {
+  UTILS_PROBE(prod, c);
+  using return_type = typename std::decay_t<decltype(*(std::declval<C>().begin()))>;
+  if (std::ranges::size(c) <= detail::cache_chunk<return_type>) {
+    return prod(std::forward<C>(c));
+  }
+  return detail::parallel_reduce(
+      detail::pool_of(policy), c, [](auto chunk) { return prod(chunk); },
+      [](return_type a, return_type b) { return a * b; });
+}
+
+/*
+bump_arena: a memory_resource that hands out memory by bumping an offset
+through a list of blocks and never frees individual allocations. rewinding
+(reset, or leaving an arena_scope) keeps the blocks, so a steady stream of
+requests stops touching malloc after the first few. pass &arena (or any
+memory_resource* / allocator) as the last argument of map, select, range,
+slice and to_vector to build their results in it:
+  utils::arena_scope request;
+  auto evens = utils::select(v, is_even, request.resource());
+results must not be used after the scope that owns their memory ends.
+*/
+class bump_arena : public std::pmr::memory_resource {
+public:
+  struct marker {
+    std::size_t block = 0;
+    std::size_t offset = 0;
+  };
+
+  explicit bump_arena(
+      std::size_t block_size = 1 << 20,
+      std::pmr::memory_resource *upstream = std::pmr::new_delete_resource())
+      : _block_size(std::max<std::size_t>(block_size, 64)),
+        _upstream(upstream) {}
+  bump_arena(const bump_arena &) = delete;
+  bump_arena &operator=(const bump_arena &) = delete;
+  ~bump_arena() override {
+    for (auto &b : _blocks) {
+      _upstream->deallocate(b.data, b.size, alignof(std::max_align_t));
+    }
+  }
+
+  marker mark() const { return marker{_current, _offset}; }
+  // everything allocated after m becomes free memory again
+  void rewind(marker m) noexcept {
+    _current = m.block;
+    _offset = m.offset;
+  }
+  void reset() noexcept { rewind(marker{}); }
+
+  std::size_t bytes_used() const {
+    std::size_t used = _offset;
+    for (std::size_t i = 0; i < _current && i < _blocks.size(); ++i) {
+      used += _blocks[i].size;
+    }
+    return used;
+  }
+  std::size_t capacity() const {
+    std::size_t total = 0;
+    for (const auto &b : _blocks) {
+      total += b.size;
+    }
+    return total;
+  }
+
+private:
+  struct block {
+    std::byte *data;
+    std::size_t size;
+  };
+
+  void *do_allocate(std::size_t bytes, std::size_t alignment) override {
+    while (_current < _blocks.size()) {
+      auto &b = _blocks[_current];
+      std::size_t aligned = (_offset + alignment - 1) & ~(alignment - 1);
+      if (aligned + bytes <= b.size) {
+        _offset = aligned + bytes;
+        return b.data + aligned;
+      }
+      // 当前块放不下就换下一块,剩下的空间等到rewind再用
+      ++_current;
+      _offset = 0;
+    }
+    std::size_t size = std::max(_block_size, bytes + alignment);
+    auto *data = static_cast<std::byte *>(
+        _upstream->allocate(size, alignof(std::max_align_t)));
+    _blocks.push_back(block{data, size});
+    _current = _blocks.size() - 1;
+    std::size_t aligned =
+        static_cast<std::size_t>(-reinterpret_cast<std::uintptr_t>(data)) &
+        (alignment - 1);
+    _offset = aligned + bytes;
+    return data + aligned;
+  }
+
+  void do_deallocate(void *, std::size_t, std::size_t) override {}
+
+  bool do_is_equal(const std::pmr::memory_resource &other) const
+      noexcept override {
+    return this == &other;
+  }
+
+  std::vector<block> _blocks;
+  std::size_t _current = 0;
+  std::size_t _offset = 0;
+  std::size_t _block_size;
+  std::pmr::memory_resource *_upstream;
+};
+
+// one arena per thread, sized for a typical batch
+inline bump_arena &thread_arena() {
+  static thread_local bump_arena arena;
+  return arena;
+}
+
+// rewinds the arena to where it was on construction, scopes may nest
+class arena_scope {
+public:
+  explicit arena_scope(bump_arena &arena = thread_arena())
+      : _arena(arena), _mark(arena.mark()) {}
+  arena_scope(const arena_scope &) = delete;
+  arena_scope &operator=(const arena_scope &) = delete;
+  ~arena_scope() { _arena.rewind(_mark); }
+
+  bump_arena *resource() const { return &_arena; }
+
+private:
+  bump_arena &_arena;
+  bump_arena::marker _mark;
+};
+
+namespace detail {
+// coroutine frames recycled through per thread free lists, one list per 64
+// byte size class. a pipeline that keeps creating generators of the same
+// shape reuses the frames of the finished ones instead of calling new
+class frame_pool {
+public:
+  static constexpr std::size_t granularity = 64;
+  static constexpr std::size_t classes = 32; // frames up to 2 KiB
+  static constexpr std::size_t max_cached = 64;
+
+  frame_pool() = default;
+  frame_pool(const frame_pool &) = delete;
+  frame_pool &operator=(const frame_pool &) = delete;
+  ~frame_pool() {
+    for (auto &list : _free) {
+      while (list.head != nullptr) {
+        ::operator delete(std::exchange(list.head, list.head->next));
+      }
+    }
+  }
+
+  void *allocate(std::size_t bytes) {
+    std::size_t c = size_class(bytes);
+    if (c >= classes) {
+      return ::operator new(bytes);
+    }
+    free_list &list = _free[c];
+    if (list.head != nullptr) {
+      --list.count;
+      return std::exchange(list.head, list.head->next);
+    }
+    return ::operator new((c + 1) * granularity);
+  }
+
+  // frames may be freed by another thread than the one that allocated them
+  void deallocate(void *p, std::size_t bytes) noexcept {
+    std::size_t c = size_class(bytes);
+    if (c >= classes || _free[c].count == max_cached) {
+      ::operator delete(p);
+      return;
+    }
+    free_list &list = _free[c];
+    list.head = ::new (p) node{list.head};
+    ++list.count;
+  }
+
+  static frame_pool &local() {
+    static thread_local frame_pool pool;
+    return pool;
+  }
+
+private:
+  struct node {
+    node *next;
+  };
+  struct free_list {
+    node *head = nullptr;
+    std::size_t count = 0;
+  };
+
+  static std::size_t size_class(std::size_t bytes) {
+    return bytes == 0 ? 0 : (bytes - 1) / granularity;
+  }
+
+  std::array<free_list, classes> _free{};
+};
+} // namespace detail
+
+// co_yield utils::elements_of(g) yields every value of the generator g
+template <typename G> struct elements_of {
+  G range;
+};
+template <typename G> elements_of(G &&) -> elements_of<G &&>;
+
+/*
+generator<T> is a single pass, lazily evaluated view of the values a
+coroutine co_yields, so unbounded or slowly produced sources can be fed to
+the utilities:
+  utils::generator<std::uint64_t> collatz(std::uint64_t n) {
+    while (n != 1) {
+      co_yield n;
+      n = n % 2 ? 3 * n + 1 : n / 2;
+    }
+    co_yield 1;
+  }
+  utils::sum(collatz(27));
+  for (auto [i, x] : utils::enumerate(utils::map(f, read_lines(file)))) ...
+map and select of a generator are generators again, enumerate and zip of
+one are views, the reductions (sum, prod, minmax, fold...) consume it one
+value at a time, so memory stays constant however long the stream is.
+co_yield utils::elements_of(g) hands over to a nested generator by
+symmetric transfer: resuming the innermost one is O(1) and recursion does
+not grow the stack. frames come from a per thread recycling pool. an
+exception thrown by the coroutine propagates out of begin() or ++it.
+*/
+template <typename T> class generator : public std::ranges::view_base {
+  static_assert(std::is_object_v<T> && !std::is_const_v<T>,
+                "generator: T must be a non-const object type");
+
+public:
+  using value_type = T;
+  class promise_type;
+  using handle_type = std::coroutine_handle<promise_type>;
+
+  class promise_type {
+  public:
+    promise_type() = default;
+
+    generator get_return_object() noexcept {
+      _leaf = handle_type::from_promise(*this);
+      return generator(_leaf);
+    }
+    std::suspend_always initial_suspend() const noexcept { return {}; }
+
+    // a finished nested generator resumes the one that yielded it
+    struct final_awaiter {
+      bool await_ready() const noexcept { return false; }
+      std::coroutine_handle<>
+      await_suspend(handle_type handle) const noexcept {
+        promise_type &promise = handle.promise();
+        if (promise._parent) {
+          promise._root->_leaf = promise._parent;
+          return promise._parent;
+        }
+        return std::noop_coroutine();
+      }
+      void await_resume() const noexcept {}
+    };
+    final_awaiter final_suspend() const noexcept { return {}; }
+
+    std::suspend_always yield_value(T &&value) noexcept {
+      _root->_value = std::addressof(value);
+      return {};
+    }
+
+    // an lvalue is copied into the awaiter, which lives in the frame while
+    // the coroutine is suspended
+    struct copy_awaiter {
+      T value;
+      promise_type *root;
+      bool await_ready() const noexcept { return false; }
+      void await_suspend(std::coroutine_handle<>) noexcept {
+        root->_value = std::addressof(value);
+      }
+      void await_resume() const noexcept {}
+    };
+    copy_awaiter yield_value(const T &value) requires
+        std::copy_constructible<T> {
+      return copy_awaiter{value, _root};
+    }
+
+    struct nested_awaiter {
+      generator nested;
+      bool await_ready() const noexcept { return !nested._handle; }
+      handle_type await_suspend(handle_type parent) noexcept {
+        promise_type &inner = nested._handle.promise();
+        inner._root = parent.promise()._root;
+        inner._parent = parent;
+        inner._root->_leaf = nested._handle;
+        return nested._handle;
+      }
+      void await_resume() {
+        if (nested._handle) {
+          nested._handle.promise().rethrow_if_failed();
+        }
+      }
+    };
+    template <typename G>
+    requires std::same_as<std::remove_cvref_t<G>, generator>
+    nested_awaiter yield_value(elements_of<G> nested) noexcept {
+      return nested_awaiter{std::move(nested.range)};
+    }
+
+    // a generator only yields
+    template <typename U> void await_transform(U &&) = delete;
+
+    void return_void() const noexcept {}
+    void unhandled_exception() noexcept {
+      _exception = std::current_exception();
+    }
+    void rethrow_if_failed() {
+      if (_exception) {
+        std::rethrow_exception(std::exchange(_exception, nullptr));
+      }
+    }
+
+    static void *operator new(std::size_t bytes) {
+      return detail::frame_pool::local().allocate(bytes);
+    }
+    static void operator delete(void *p, std::size_t bytes) noexcept {
+      detail::frame_pool::local().deallocate(p, bytes);
+    }
+
+  private:
+    friend class generator;
+    // the outermost generator tracks the innermost active one (_leaf) and
+    // the current value for all of them
+    promise_type *_root = this;
+    handle_type _leaf;
+    handle_type _parent;
+    T *_value = nullptr;
+    std::exception_ptr _exception;
+  };
+
+  class iterator {
+  public:
+    using iterator_concept = std::input_iterator_tag;
+    using value_type = T;
+    using reference = T &;
+    using difference_type = std::ptrdiff_t;
+
+    iterator() = default;
+    explicit iterator(handle_type handle) : _handle(handle) {}
+
+    T &operator*() const { return *_handle.promise()._value; }
+    iterator &operator++() {
+      promise_type &root = _handle.promise();
+      root._leaf.resume();
+      root.rethrow_if_failed();
+      return *this;
+    }
+    void operator++(int) { ++*this; }
+
+    friend bool operator==(const iterator &it, std::default_sentinel_t) {
+      return !it._handle || it._handle.done();
+    }
+
+  private:
+    handle_type _handle;
+  };
+
+  generator() = default;
+  generator(generator &&other) noexcept
+      : _handle(std::exchange(other._handle, nullptr)) {}
+  generator &operator=(generator other) noexcept {
+    std::swap(_handle, other._handle);
+    return *this;
+  }
+  ~generator() {
+    if (_handle) {
+      _handle.destroy();
+    }
+  }
+
+  // runs the coroutine to its first co_yield, a generator can only be
+  // iterated once
+  iterator begin() {
+    if (_handle) {
+      _handle.resume();
+      _handle.promise().rethrow_if_failed();
+    }
+    return iterator(_handle);
+  }
+  std::default_sentinel_t end() const noexcept { return {}; }
+
+private:
+  explicit generator(handle_type handle) : _handle(handle) {}
+  handle_type _handle;
+};
+
+namespace detail {
+template <typename R, typename F, typename V>
+generator<R> map_stream(F f, V source) {
+  for (auto &&val : source) {
+    co_yield f(val);
+  }
+}
+
+template <typename Predicate, typename V>
+generator<std::ranges::range_value_t<V>> select_stream(Predicate pred,
+                                                       V source) {
+  for (auto &&val : source) {
+    if (pred(val)) {
+      co_yield val;
+    }
+  }
+}
+
+// an rvalue generator moves into the stream, an lvalue one is referenced
+// (a move-only view is not a viewable_range as an lvalue)
+template <typename C> auto stream_source(C &&c) {
+  if constexpr (std::is_lvalue_reference_v<C>) {
+    return std::ranges::ref_view(c);
+  } else {
+    return std::remove_cvref_t<C>(std::move(c));
+  }
+}
+} // namespace detail
+
+// a standard allocator or a memory_resource* for the vector a utility returns
+template <typename A>
+concept ResultAllocator =
+    std::convertible_to<A, std::pmr::memory_resource *> ||
+    requires(A a) {
+  // checked first, allocator_traits of a non allocator is a hard error
+  typename A::value_type;
+  typename std::allocator_traits<A>::value_type;
+  a.allocate(std::size_t(1));
+};
+
+namespace detail {
+template <typename T, ResultAllocator A>
+constexpr auto rebind_alloc(const A &alloc) {
+  if constexpr (std::convertible_to<A, std::pmr::memory_resource *>) {
+    return std::pmr::polymorphic_allocator<T>(
+        static_cast<std::pmr::memory_resource *>(alloc));
+  } else {
+    return typename std::allocator_traits<A>::template rebind_alloc<T>(alloc);
+  }
+}
+
+template <typename T, typename A>
+using result_vector_t =
+    std::vector<T, decltype(rebind_alloc<T>(std::declval<const A &>()))>;
+} // namespace detail
+
+// map/transform
+// the result vector is allocated with alloc (an allocator or memory_resource*)
+template <typename F, typename C, ResultAllocator A>
+requires requires(C c) {
+  {c.begin()};
+  {c.end()};
+} && std::invocable<F,
+                    typename std::decay_t<decltype(*std::declval<C>().begin())>>
+constexpr auto map(F &&f, C &&c, const A &alloc) {
+  UTILS_PROBE(map, c);
+  using InputType = typename std::decay_t<decltype(*c.begin())>;
+  using ResultType = std::decay_t<decltype(f(std::declval<InputType>()))>;
+  detail::result_vector_t<ResultType, A> result(
+      detail::rebind_alloc<ResultType>(alloc));
+  if constexpr (std::ranges::sized_range<C>) {
+    result.reserve(std::ranges::size(c));
+  }
+  for (const auto &val : c) {
+    result.push_back(f(val));
+  }
+  return result;
+}
+
+template <typename F, typename C>
+requires requires(C c) {
+  {c.begin()};
+  {c.end()};
+} && std::invocable<F,
+                    typename std::decay_t<decltype(*std::declval<C>().begin())>>
+constexpr auto map(F &&f, C &&c) {
+  UTILS_PROBE(map, c);
+  using InputType = typename std::decay_t<decltype(*c.begin())>;
+  using ResultType = std::decay_t<decltype(f(std::declval<InputType>()))>;
+  if constexpr (Generator<C>) {
+    // stays lazy, an lvalue generator is referenced and must outlive the
+    // result
+    return detail::map_stream<ResultType>(
+        std::forward<F>(f), detail::stream_source(std::forward<C>(c)));
+  } else if constexpr (Tensor<C>) {
+    // tensors keep their shape, the result is a dense row-major tensor
+    tensor<ResultType, std::remove_cvref_t<C>::rank()> result(c.shape());
+    auto out = result.begin();
+    for (const auto &val : c) {
+      *out++ = f(val);
+    }
+    return result;
+  } else {
+    return map(std::forward<F>(f), std::forward<C>(c),
+               std::allocator<ResultType>());
+  }
+}
+
+// fixed size in, fixed size out, so tables can be built at compile time
+template <typename F, typename T, std::size_t N>
+requires std::invocable<F, const T &> &&
+    std::default_initializable<std::decay_t<std::invoke_result_t<F, const T &>>>
+constexpr auto map_array(F &&f, const std::array<T, N> &c) {
+  UTILS_PROBE(map, c);
+  std::array<std::decay_t<std::invoke_result_t<F, const T &>>, N> result{};
+  for (std::size_t i = 0; i < N; ++i) {
+    result[i] = f(c[i]);
+  }
+  return result;
+}
+
+// order preserving parallel map, each chunk writes its own slice of the result
+template <ExecutionPolicy P, typename F, detail::ParallelInput C>
+requires std::invocable<
+    F, typename std::decay_t<decltype(*std::declval<C>().begin())>>
+auto map(P &&policy, F &&f, C &&c) {
+  UTILS_PROBE(map, c);
+  using InputType = typename std::decay_t<decltype(*c.begin())>;
+  using ResultType = std::decay_t<decltype(f(std::declval<InputType>()))>;
+  if constexpr (!std::default_initializable<ResultType>) {
+    return map(std::forward<F>(f), std::forward<C>(c));
+  } else {
+    auto &pool = detail::pool_of(policy);
+    std::size_t n = std::ranges::size(c);
+    std::size_t chunk = detail::elementwise_chunk<InputType>(n, pool.size());
+    std::vector<ResultType> result(n);
+    auto first = std::ranges::begin(c);
+    pool.parallel_for((n + chunk - 1) / chunk, [&](std::size_t i) {
+      for (std::size_t j = i * chunk; j < std::min(n, (i + 1) * chunk); ++j) {
+        result[j] = f(first[static_cast<std::ptrdiff_t>(j)]);
+      }
+    });
+    return result;
+  }
+}
+
+inline std::string shape_to_string(ContainerWithPrintableElement auto &&shape) {
+  std::stringstream ss;
+  ss << "[";
+  for (auto it = shape.begin(); it != shape.end(); it++) {
+    ss << (*it);
+    if (it + 1 != shape.end()) {
+      ss << ",";
+    }
+  }
+  ss << "]";
+  return ss.str();
+}
+
+inline std::string
+shape_to_string(NestedContainerWithPrintableElement auto &&shape) {
+  std::stringstream ss;
+  ss << "[";
+  for (auto it = shape.begin(); it != shape.end(); it++) {
+    ss << "[";
+    for (auto sub_it = (*it).begin(); sub_it != (*it).end(); sub_it++) {
+      ss << (*sub_it);
+      if (sub_it + 1 != (*it).end()) {
+        ss << ",";
+      }
+      // else {
+      //   ss << "]";
+      // }
+    }
+    ss << "]";
+    if (it + 1 != shape.end()) {
+      ss << ",";
+    }
+  }
+  ss << "]";
+  return ss.str();
+}
+
+// how minmax/argmax/argmin treat NaN: propagate returns NaN (the index of the
+// first NaN for argmax/argmin), ignore skips NaN like numpy's nanmax
+enum class nan_policy { propagate, ignore };
+
+namespace detail {
+template <typename T> struct minmax_result {
+  T min;
+  T max;
+  bool has_nan;
+};
+
+// identities of min/max, NaN never replaces them since comparisons with NaN
+// are false
+template <typename T> constexpr T min_identity() {
+  if constexpr (std::numeric_limits<T>::has_infinity) {
+    return std::numeric_limits<T>::infinity();
+  } else {
+    return std::numeric_limits<T>::max();
+  }
+}
+
+template <typename T> constexpr T max_identity() {
+  if constexpr (std::numeric_limits<T>::has_infinity) {
+    return -std::numeric_limits<T>::infinity();
+  } else {
+    return std::numeric_limits<T>::lowest();
+  }
+}
+
+template <typename T, std::size_t Bytes>
+UTILS_ALWAYS_INLINE minmax_result<T> minmax_kernel(const T *data,
+                                                   std::size_t n) {
+  minmax_result<T> result{min_identity<T>(), max_identity<T>(), false};
+  std::size_t i = 0;
+#if defined(__GNUC__)
+  typedef T vec __attribute__((vector_size(Bytes)));
+  using mask = decltype(vec{} != vec{});
+  constexpr std::size_t lanes = Bytes / sizeof(T);
+  constexpr std::size_t unroll = 2;
+  vec mn[unroll];
+  vec mx[unroll];
+  mask nan[unroll];
+  for (std::size_t u = 0; u < unroll; ++u) {
+    mn[u] = vec{} + min_identity<T>();
+    mx[u] = vec{} + max_identity<T>();
+    nan[u] = mask{};
+  }
+  for (; i + unroll * lanes <= n; i += unroll * lanes) {
+    for (std::size_t u = 0; u < unroll; ++u) {
+      vec x;
+      std::memcpy(&x, data + i + u * lanes, Bytes);
+      mn[u] = x < mn[u] ? x : mn[u];
+      mx[u] = x > mx[u] ? x : mx[u];
+      if constexpr (std::is_floating_point_v<T>) {
+        nan[u] |= (x != x);
+      }
+    }
+  }
+  for (std::size_t u = 0; u < unroll; ++u) {
+    for (std::size_t j = 0; j < lanes; ++j) {
+      result.min = mn[u][j] < result.min ? mn[u][j] : result.min;
+      result.max = mx[u][j] > result.max ? mx[u][j] : result.max;
+      result.has_nan = result.has_nan || nan[u][j] != 0;
+    }
+  }
+#endif
+  for (; i < n; ++i) {
+    result.min = data[i] < result.min ? data[i] : result.min;
+    result.max = data[i] > result.max ? data[i] : result.max;
+    if constexpr (std::is_floating_point_v<T>) {
+      result.has_nan = result.has_nan || data[i] != data[i];
+    }
+  }
+  return result;
+}
+
+#if UTILS_X86_DISPATCH
+template <typename T>
+__attribute__((target("avx2"))) minmax_result<T>
+minmax_avx2(const T *data, std::size_t n) {
+  return minmax_kernel<T, 32>(data, n);
+}
+
+template <typename T>
+__attribute__((target("avx512f"))) minmax_result<T>
+minmax_avx512(const T *data, std::size_t n) {
+  return minmax_kernel<T, 64>(data, n);
+}
+#endif
+
+template <typename T>
+minmax_result<T> minmax_contiguous(const T *data, std::size_t n) {
+#if UTILS_X86_DISPATCH
+  switch (detect_simd_level()) {
+  case simd_level::avx512:
+    return minmax_avx512(data, n);
+  case simd_level::avx2:
+    return minmax_avx2(data, n);
+  default:
+    break;
+  }
+#endif
+  return minmax_kernel<T, 16>(data, n);
+}
+
+template <typename T> constexpr bool is_nan(const T &val) {
+  if constexpr (std::is_floating_point_v<T>) {
+    return val != val;
+  } else {
+    return false;
+  }
+}
+
+[[noreturn]] inline void throw_empty() {
+  throw std::runtime_error(
+      std::string("container must contain at least one element!"));
+}
+
+[[noreturn]] inline void throw_all_nan() {
+  throw std::runtime_error(std::string("all elements are NaN!"));
+}
+
+/*
+argmax/argmin over a contiguous buffer: one SIMD minmax pass per L1 sized
+block remembers the block holding the best value, only that block is scanned
+again to find the index of its first occurrence.
+*/
+template <bool Max, typename T>
+std::size_t arg_extreme_contiguous(const T *data, std::size_t n,
+                                   nan_policy policy) {
+  constexpr std::size_t block = 4096;
+  constexpr std::size_t npos = static_cast<std::size_t>(-1);
+  std::size_t best_block = npos;
+  T best{};
+  for (std::size_t b = 0; b < n; b += block) {
+    std::size_t len = std::min(block, n - b);
+    auto r = minmax_contiguous(data + b, len);
+    if (r.has_nan && policy == nan_policy::propagate) {
+      return static_cast<std::size_t>(
+          std::find_if(data + b, data + b + len,
+                       [](const T &val) { return is_nan(val); }) -
+          data);
+    }
+    if (r.min > r.max) {
+      continue; // only NaN in this block
+    }
+    T val = Max ? r.max : r.min;
+    if (best_block == npos || (Max ? best < val : val < best)) {
+      best = val;
+      best_block = b;
+    }
+  }
+  if (best_block == npos) {
+    throw_all_nan();
+  }
+  return static_cast<std::size_t>(
+      std::find(data + best_block, data + n, best) - data);
+}
+
+template <bool Max, typename C>
+std::size_t arg_extreme(C &&c, nan_policy policy) {
+  using T = std::ranges::range_value_t<C>;
+  if constexpr (ContiguousSimdRange<C>) {
+    if (std::ranges::size(c) == 0) {
+      throw_empty();
+    }
+    return arg_extreme_contiguous<Max>(std::ranges::data(c),
+                                       std::ranges::size(c), policy);
+  } else {
+    constexpr std::size_t npos = static_cast<std::size_t>(-1);
+    std::size_t best_index = npos;
+    std::size_t index = 0;
+    bool empty = true;
+    std::optional<T> best;
+    for (const auto &val : c) {
+      empty = false;
+      if (is_nan(val)) {
+        if (policy == nan_policy::propagate) {
+          return index;
+        }
+      } else if (!best || (Max ? *best < val : val < *best)) {
+        best = val;
+        best_index = index;
+      }
+      ++index;
+    }
+    if (empty) {
+      throw_empty();
+    }
+    if (best_index == npos) {
+      throw_all_nan();
+    }
+    return best_index;
+  }
+}
+} // namespace detail
+
+/*
+minmax(c) returns {min, max} in a single pass, vectorized for contiguous
+arithmetic ranges (std::vector, std::array, std::span over a raw buffer...).
+reference to : https://reference.wolfram.com/language/ref/MinMax.html
+*/
+template <std::ranges::input_range C>
+requires Comparable<std::ranges::range_value_t<C>>
+constexpr auto minmax(C &&c, nan_policy policy = nan_policy::propagate) {
+  UTILS_PROBE(minmax, c);
+  using T = std::ranges::range_value_t<C>;
+  if constexpr (detail::ContiguousSimdRange<C>) {
+    if (!std::is_constant_evaluated()) {
+      if (std::ranges::size(c) == 0) {
+        detail::throw_empty();
+      }
+      auto r = detail::minmax_contiguous(std::ranges::data(c),
+                                         std::ranges::size(c));
+      // min > max can only happen when every element is NaN
+      if (r.has_nan && (policy == nan_policy::propagate || r.min > r.max)) {
+        return std::pair<T, T>(std::numeric_limits<T>::quiet_NaN(),
+                               std::numeric_limits<T>::quiet_NaN());
+      }
+      return std::pair<T, T>(r.min, r.max);
+    }
+  } else if constexpr (detail::ChunkedSource<C>) {
+    std::optional<std::pair<T, T>> result;
+    bool empty = true;
+    bool nan = false;
+    c.for_each_chunk([&](auto chunk) {
+      if (nan || chunk.empty()) {
+        return;
+      }
+      empty = false;
+      auto r = minmax(chunk, policy);
+      if (detail::is_nan(r.first)) {
+        // all NaN chunks are skipped when NaNs are ignored
+        nan = policy == nan_policy::propagate;
+      } else if (!result) {
+        result = r;
+      } else {
+        result->first = std::min(result->first, r.first);
+        result->second = std::max(result->second, r.second);
+      }
+    });
+    if (empty) {
+      detail::throw_empty();
+    }
+    if (nan || !result) {
+      return std::pair<T, T>(std::numeric_limits<T>::quiet_NaN(),
+                             std::numeric_limits<T>::quiet_NaN());
+    }
+    return *result;
+  }
+  std::optional<std::pair<T, T>> result;
+  bool empty = true;
+  for (const auto &val : c) {
+    empty = false;
+    if (detail::is_nan(val)) {
+      if (policy == nan_policy::propagate) {
+        return std::pair<T, T>(val, val);
+      }
+    } else if (!result) {
+      result.emplace(val, val);
+    } else {
+      if (val < result->first) {
+        result->first = val;
+      }
+      if (result->second < val) {
+        result->second = val;
+      }
+    }
+  }
+  if (empty) {
+    detail::throw_empty();
+  }
+  if (!result) {
+    // every element is NaN
+    return std::pair<T, T>(std::numeric_limits<T>::quiet_NaN(),
+                           std::numeric_limits<T>::quiet_NaN());
+  }
+  return *result;
+}
+
+// index of the first largest element
+template <std::ranges::input_range C>
+requires Comparable<std::ranges::range_value_t<C>>
+std::size_t argmax(C &&c, nan_policy policy = nan_policy::propagate) {
+  return detail::arg_extreme<true>(std::forward<C>(c), policy);
+}
+
+// index of the first smallest element
+template <std::ranges::input_range C>
+requires Comparable<std::ranges::range_value_t<C>>
+std::size_t argmin(C &&c, nan_policy policy = nan_policy::propagate) {
+  return detail::arg_extreme<false>(std::forward<C>(c), policy);
+}
+
+constexpr auto max(const Comparable auto &a, const Comparable auto &b) {
+  return a < b ? b : a;
+}
+
+template <Comparable... Args>
+constexpr auto max(const Comparable auto &a, const Args &...args) {
+  return utils::max(a, utils::max(args...));
+}
+
+template <std::ranges::input_range C>
+requires Comparable<std::ranges::range_value_t<C>>
+constexpr auto max(const C &container) {
+  return utils::minmax(container).second;
+}
+
+constexpr auto min(const Comparable auto &a, const Comparable auto &b) {
+  return a < b ? a : b;
+}
+
+template <Comparable... Args>
+constexpr auto min(const Comparable auto &a, const Args &...args) {
+  return utils::min(a, utils::min(args...));
+}
+
+template <std::ranges::input_range C>
+requires Comparable<std::ranges::range_value_t<C>>
+constexpr auto min(const C &container) {
+  return utils::minmax(container).first;
+}
+
+namespace detail {
+template <bool Const, typename T>
+using maybe_const_t = std::conditional_t<Const, const T, T>;
+
+template <bool Const, typename... Vs>
+concept all_random_access =
+    (std::ranges::random_access_range<maybe_const_t<Const, Vs>> && ...);
+
+template <bool Const, typename... Vs>
+concept all_bidirectional =
+    (std::ranges::bidirectional_range<maybe_const_t<Const, Vs>> && ...);
+
+template <bool Const, typename... Vs>
+concept all_forward =
+    (std::ranges::forward_range<maybe_const_t<Const, Vs>> && ...);
+
+template <bool Const, typename... Vs>
+concept all_sized = (std::ranges::sized_range<maybe_const_t<Const, Vs>> && ...);
+
+// 单个common range,或者全部是可随机访问且已知长度的range时,end()可以直接返回迭代器
+template <bool Const, typename... Vs>
+concept zip_is_common =
+    (sizeof...(Vs) == 1 &&
+     (std::ranges::common_range<maybe_const_t<Const, Vs>> && ...)) ||
+    (all_random_access<Const, Vs...> && all_sized<Const, Vs...>);
+} // namespace detail
+
+/*
+zip(c1,c2,c3...) iterates over several ranges in lockstep and stops at the
+shortest one, like python's zip. lvalue containers are borrowed through
+std::views::all (no copy), rvalue containers are moved into the view.
+dereferencing yields a std::tuple of references into the underlying ranges.
+*/
+template <std::ranges::input_range... Vs>
+requires(sizeof...(Vs) > 0) && (std::ranges::view<Vs> && ...)
+class zip : public std::ranges::view_interface<zip<Vs...>> {
+public:
+  template <bool Const> class zipiterator {
+  public:
+    using iterator_concept = std::conditional_t<
+        detail::all_random_access<Const, Vs...>,
+        std::random_access_iterator_tag,
+        std::conditional_t<
+            detail::all_bidirectional<Const, Vs...>,
+            std::bidirectional_iterator_tag,
+            std::conditional_t<detail::all_forward<Const, Vs...>,
+                               std::forward_iterator_tag,
+                               std::input_iterator_tag>>>;
+    using value_type = std::tuple<
+        std::ranges::range_value_t<detail::maybe_const_t<Const, Vs>>...>;
+    using reference = std::tuple<
+        std::ranges::range_reference_t<detail::maybe_const_t<Const, Vs>>...>;
+    using difference_type = std::common_type_t<
+        std::ranges::range_difference_t<detail::maybe_const_t<Const, Vs>>...>;
+
+    zipiterator() = default;
+    explicit zipiterator(
+        std::tuple<std::ranges::iterator_t<detail::maybe_const_t<Const, Vs>>...>
+            its)
+        : _its(std::move(its)) {}
+    zipiterator(zipiterator<!Const> other) requires Const &&
+        (std::convertible_to<std::ranges::iterator_t<Vs>,
+                             std::ranges::iterator_t<const Vs>> &&
+         ...) : _its(std::move(other._its)) {}
+
+    reference operator*() const {
+      return std::apply([](const auto &...it) { return reference(*it...); },
+                        _its);
+    }
+
+    zipiterator &operator++() {
+      std::apply([](auto &...it) { (++it, ...); }, _its);
+      return *this;
+    }
+    void operator++(int) { ++(*this); }
+    zipiterator operator++(int) requires detail::all_forward<Const, Vs...> {
+      auto tmp = *this;
+      ++(*this); // 复用前置自增
+      return tmp;
+    }
+
+    zipiterator &operator--() requires
+        detail::all_bidirectional<Const, Vs...> {
+      std::apply([](auto &...it) { (--it, ...); }, _its);
+      return *this;
+    }
+    zipiterator operator--(int) requires
+        detail::all_bidirectional<Const, Vs...> {
+      auto tmp = *this;
+      --(*this);
+      return tmp;
+    }
+
+    zipiterator &operator+=(difference_type n) requires
+        detail::all_random_access<Const, Vs...> {
+      std::apply([n](auto &...it) { ((it += n), ...); }, _its);
+      return *this;
+    }
+    zipiterator &operator-=(difference_type n) requires
+        detail::all_random_access<Const, Vs...> {
+      std::apply([n](auto &...it) { ((it -= n), ...); }, _its);
+      return *this;
+    }
+    reference operator[](difference_type n) const
+        requires detail::all_random_access<Const, Vs...> {
+      return std::apply(
+          [n](const auto &...it) { return reference(it[n]...); }, _its);
+    }
+
+    friend bool operator==(const zipiterator &a, const zipiterator &b) requires(
+        std::equality_comparable<
+            std::ranges::iterator_t<detail::maybe_const_t<Const, Vs>>> &&
+        ...) {
+      if constexpr (detail::all_bidirectional<Const, Vs...>) {
+        return a._its == b._its;
+      } else {
+        // 只要有一个迭代器相等就认为到达末尾,与python的zip一致
+        return a.any_equal(b._its);
+      }
+    }
+    friend auto operator<=>(const zipiterator &a, const zipiterator &b) requires
+        detail::all_random_access<Const, Vs...> {
+      return std::get<0>(a._its) <=> std::get<0>(b._its);
+    }
+    friend zipiterator operator+(zipiterator it, difference_type n) requires
+        detail::all_random_access<Const, Vs...> {
+      return it += n;
+    }
+    friend zipiterator operator+(difference_type n, zipiterator it) requires
+        detail::all_random_access<Const, Vs...> {
+      return it += n;
+    }
+    friend zipiterator operator-(zipiterator it, difference_type n) requires
+        detail::all_random_access<Const, Vs...> {
+      return it -= n;
+    }
+    friend difference_type operator-(const zipiterator &a,
+                                     const zipiterator &b) requires
+        detail::all_random_access<Const, Vs...> {
+      return a.min_distance(b._its);
+    }
+
+    // zipsentinel的比较也要用到,所以是public
+    template <typename Tuple> bool any_equal(const Tuple &others) const {
+      return [&]<std::size_t... Is>(std::index_sequence<Is...>) {
+        return ((std::get<Is>(_its) == std::get<Is>(others)) || ...);
+      }
+      (std::index_sequence_for<Vs...>{});
+    }
+
+  private:
+    friend class zip;
+    // 各个迭代器之间的距离取绝对值最小的那个,保证不会越过最短的range
+    template <typename Tuple>
+    difference_type min_distance(const Tuple &others) const {
+      return [&]<std::size_t... Is>(std::index_sequence<Is...>) {
+        difference_type result = std::get<0>(_its) - std::get<0>(others);
+        ((result = (std::abs(std::get<Is>(_its) - std::get<Is>(others)) <
+                    std::abs(result))
+                       ? static_cast<difference_type>(std::get<Is>(_its) -
+                                                      std::get<Is>(others))
+                       : result),
+         ...);
+        return result;
+      }
+      (std::index_sequence_for<Vs...>{});
+    }
+
+    std::tuple<std::ranges::iterator_t<detail::maybe_const_t<Const, Vs>>...>
+        _its;
+  };
+
+  // 任意一个range到达末尾就停止迭代
+  template <bool Const> class zipsentinel {
+  public:
+    zipsentinel() = default;
+    explicit zipsentinel(
+        std::tuple<std::ranges::sentinel_t<detail::maybe_const_t<Const, Vs>>...>
+            ends)
+        : _ends(std::move(ends)) {}
+
+    friend bool operator==(const zipiterator<Const> &it,
+                           const zipsentinel &s) {
+      return it.any_equal(s._ends);
+    }
+
+  private:
+    std::tuple<std::ranges::sentinel_t<detail::maybe_const_t<Const, Vs>>...>
+        _ends;
+  };
+
+  using iterator = zipiterator<false>;
+  using const_iterator = zipiterator<true>;
+  using value_type = typename iterator::value_type;
+
+  zip() = default;
+  explicit zip(Vs... views) : _views(std::move(views)...) {}
+
+  auto begin() { return make_begin<false>(_views); }
+  auto begin() const requires(std::ranges::range<const Vs> &&...) {
+    return make_begin<true>(_views);
+  }
+  auto end() { return make_end<false>(_views); }
+  auto end() const requires(std::ranges::range<const Vs> &&...) {
+    return make_end<true>(_views);
+  }
+
+  auto size() requires detail::all_sized<false, Vs...> {
+    return std::apply(
+        [](auto &...v) {
+          return std::min({static_cast<size_t>(std::ranges::size(v))...});
+        },
+        _views);
+  }
+  auto size() const requires detail::all_sized<true, Vs...> {
+    return std::apply(
+        [](const auto &...v) {
+          return std::min({static_cast<size_t>(std::ranges::size(v))...});
+        },
+        _views);
+  }
+
+private:
+  template <bool Const, typename Views> static auto make_begin(Views &views) {
+    return zipiterator<Const>(std::apply(
+        [](auto &...v) { return std::make_tuple(std::ranges::begin(v)...); },
+        views));
+  }
+
+  template <bool Const, typename Views> static auto make_end(Views &views) {
+    if constexpr (!detail::zip_is_common<Const, Vs...>) {
+      return zipsentinel<Const>(std::apply(
+          [](auto &...v) { return std::make_tuple(std::ranges::end(v)...); },
+          views));
+    } else if constexpr (detail::all_random_access<Const, Vs...>) {
+      // end迭代器 = 每个range的begin + 最短长度,这样所有迭代器同时到达末尾
+      auto n = std::apply(
+          [](auto &...v) {
+            return std::min({static_cast<size_t>(std::ranges::size(v))...});
+          },
+          views);
+      return zipiterator<Const>(std::apply(
+          [n](auto &...v) {
+            return std::make_tuple(
+                (std::ranges::begin(v) +
+                 static_cast<std::ranges::range_difference_t<decltype(v)>>(
+                     n))...);
+          },
+          views));
+    } else {
+      return zipiterator<Const>(std::apply(
+          [](auto &...v) { return std::make_tuple(std::ranges::end(v)...); },
+          views));
+    }
+  }
+
+  std::tuple<Vs...> _views;
+};
+
+template <typename... Rs> zip(Rs &&...) -> zip<std::views::all_t<Rs>...>;
+
+/*
+enumerate(c, start = 0, step = 1) yields (index, element) pairs with
+index = start, start + step, start + 2 * step, ... like python's enumerate.
+lvalue containers are borrowed through std::views::all (no copy), rvalue
+containers are moved into the view, and the element is a reference into the
+underlying range, so enumerating nested containers never copies them.
+*/
+template <std::ranges::input_range V>
+requires std::ranges::view<V>
+class enumerate : public std::ranges::view_interface<enumerate<V>> {
+public:
+  template <bool Const> class enumerate_iterator {
+  public:
+    using Base = detail::maybe_const_t<Const, V>;
+    using iterator_concept = std::conditional_t<
+        std::ranges::random_access_range<Base>, std::random_access_iterator_tag,
+        std::conditional_t<
+            std::ranges::bidirectional_range<Base>,
+            std::bidirectional_iterator_tag,
+            std::conditional_t<std::ranges::forward_range<Base>,
+                               std::forward_iterator_tag,
+                               std::input_iterator_tag>>>;
+    using value_type =
+        std::tuple<uint64_t, std::ranges::range_value_t<Base>>;
+    using reference =
+        std::tuple<uint64_t, std::ranges::range_reference_t<Base>>;
+    using difference_type = std::ranges::range_difference_t<Base>;
+
+    enumerate_iterator() = default;
+    enumerate_iterator(std::ranges::iterator_t<Base> it, uint64_t count,
+                       uint64_t step)
+        : _it(std::move(it)), _count(count), _step(step) {}
+    enumerate_iterator(enumerate_iterator<!Const> other) requires Const &&
+        std::convertible_to<std::ranges::iterator_t<V>,
+                            std::ranges::iterator_t<const V>>
+        : _it(std::move(other._it)), _count(other._count),
+          _step(other._step) {}
+
+    reference operator*() const { return reference(_count, *_it); }
+    reference operator[](difference_type n) const
+        requires std::ranges::random_access_range<Base> {
+      return reference(_count + static_cast<uint64_t>(n) * _step, _it[n]);
+    }
+    uint64_t index() const { return _count; }
+    const std::ranges::iterator_t<Base> &base() const { return _it; }
+
+    enumerate_iterator &operator++() {
+      ++_it;
+      _count += _step;
+      return *this;
+    }
+    void operator++(int) { ++(*this); }
+    enumerate_iterator operator++(int) requires
+        std::ranges::forward_range<Base> {
+      auto tmp = *this;
+      ++(*this);
+      return tmp;
+    }
+    enumerate_iterator &operator--() requires
+        std::ranges::bidirectional_range<Base> {
+      --_it;
+      _count -= _step;
+      return *this;
+    }
+    enumerate_iterator operator--(int) requires
+        std::ranges::bidirectional_range<Base> {
+      auto tmp = *this;
+      --(*this);
+      return tmp;
+    }
+    enumerate_iterator &operator+=(difference_type n) requires
+        std::ranges::random_access_range<Base> {
+      _it += n;
+      _count += static_cast<uint64_t>(n) * _step;
+      return *this;
+    }
+    enumerate_iterator &operator-=(difference_type n) requires
+        std::ranges::random_access_range<Base> {
+      return *this += -n;
+    }
+
+    friend bool operator==(const enumerate_iterator &a,
+                           const enumerate_iterator &b) requires
+        std::equality_comparable<std::ranges::iterator_t<Base>> {
+      return a._it == b._it;
+    }
+    friend auto operator<=>(const enumerate_iterator &a,
+                            const enumerate_iterator &b) requires
+        std::ranges::random_access_range<Base> {
+      return a._it <=> b._it;
+    }
+    friend enumerate_iterator operator+(enumerate_iterator it,
+                                        difference_type n) requires
+        std::ranges::random_access_range<Base> {
+      return it += n;
+    }
+    friend enumerate_iterator operator+(difference_type n,
+                                        enumerate_iterator it) requires
+        std::ranges::random_access_range<Base> {
+      return it += n;
+    }
+    friend enumerate_iterator operator-(enumerate_iterator it,
+                                        difference_type n) requires
+        std::ranges::random_access_range<Base> {
+      return it -= n;
+    }
+    friend difference_type operator-(const enumerate_iterator &a,
+                                     const enumerate_iterator &b) requires
+        std::ranges::random_access_range<Base> {
+      return a._it - b._it;
+    }
+
+  private:
+    friend class enumerate;
+    std::ranges::iterator_t<Base> _it;
+    uint64_t _count = 0;
+    uint64_t _step = 1;
+  };
+
+  // 只比较底层迭代器,计数不参与
+  template <bool Const> class enumerate_sentinel {
+  public:
+    using Base = detail::maybe_const_t<Const, V>;
+    enumerate_sentinel() = default;
+    explicit enumerate_sentinel(std::ranges::sentinel_t<Base> end)
+        : _end(std::move(end)) {}
+
+    friend bool operator==(const enumerate_iterator<Const> &it,
+                           const enumerate_sentinel &s) {
+      return it.base() == s._end;
+    }
+
+  private:
+    std::ranges::sentinel_t<Base> _end;
+  };
+
+  using iterator = enumerate_iterator<false>;
+  using const_iterator = enumerate_iterator<true>;
+  using value_type = typename iterator::value_type;
+
+  enumerate() = default;
+  explicit enumerate(V base, uint64_t start = 0, uint64_t step = 1)
+      : _base(std::move(base)), _start(start), _step(step) {}
+
+  auto begin() { return make_begin<false>(_base); }
+  auto begin() const requires std::ranges::range<const V> {
+    return make_begin<true>(_base);
+  }
+  auto end() { return make_end<false>(_base); }
+  auto end() const requires std::ranges::range<const V> {
+    return make_end<true>(_base);
+  }
+
+  auto size() requires std::ranges::sized_range<V> {
+    return std::ranges::size(_base);
+  }
+  auto size() const requires std::ranges::sized_range<const V> {
+    return std::ranges::size(_base);
+  }
+
+private:
+  template <bool Const, typename Base> auto make_begin(Base &base) const {
+    return enumerate_iterator<Const>(std::ranges::begin(base), _start, _step);
+  }
+
+  template <bool Const, typename Base> auto make_end(Base &base) const {
+    if constexpr (std::ranges::common_range<Base> &&
+                  std::ranges::sized_range<Base>) {
+      // end的计数也要正确,这样反向遍历时索引从最后一个元素开始
+      return enumerate_iterator<Const>(
+          std::ranges::end(base),
+          _start + static_cast<uint64_t>(std::ranges::size(base)) * _step,
+          _step);
+    } else {
+      return enumerate_sentinel<Const>(std::ranges::end(base));
+    }
+  }
+
+  V _base = V();
+  uint64_t _start = 0;
+  uint64_t _step = 1;
+};
+
+template <typename R>
+enumerate(R &&) -> enumerate<std::views::all_t<R>>;
+template <typename R>
+enumerate(R &&, uint64_t) -> enumerate<std::views::all_t<R>>;
+template <typename R>
+enumerate(R &&, uint64_t, uint64_t) -> enumerate<std::views::all_t<R>>;
+
+template <std::size_t... Is>
 constexpr auto make_index_tuple(std::index_sequence<Is...>) {
   return std::make_tuple(Is...); // 生成包含索引值的元组
 }
 
-template <std::size_t N> auto vunpack(ContainerWithArithmeticElement auto &&c) {
-  if constexpr (N <= 0) {
-    throw std::runtime_error("vunpack: N must be greater than 0");
+template <std::size_t N> auto vunpack(ContainerWithArithmeticElement auto &&c) {
+  if constexpr (N <= 0) {
+    throw std::runtime_error("vunpack: N must be greater than 0");
+  }
+  if (c.size() < N) {
+    throw std::runtime_error("vunpack: container size less than N");
+  }
+  return [&c]<std::size_t... Is>(std::index_sequence<Is...>) {
+    return std::make_tuple(c[Is]...);
+  }
+  (std::make_index_sequence<N>{});
+}
+
+template <std::size_t N>
+auto vunpack(NestedContainerWithArithmeticElement auto &&c) {
+  if constexpr (N <= 0) {
+    throw std::runtime_error("vunpack: N must be greater than 0");
+  }
+  if (c.size() < N) {
+    throw std::runtime_error("vunpack: container size less than N");
+  }
+  return [&c]<std::size_t... Is>(std::index_sequence<Is...>) {
+    return std::make_tuple(c[Is]...);
+  }
+  (std::make_index_sequence<N>{});
+}
+
+namespace detail {
+// 64字节对齐: 一条cache line,AVX-512的整向量load也不会跨行
+template <typename T> struct aligned_allocator {
+  using value_type = T;
+  static constexpr std::align_val_t alignment{
+      std::max<std::size_t>(64, alignof(T))};
+
+  aligned_allocator() = default;
+  template <typename U> aligned_allocator(const aligned_allocator<U> &) {}
+
+  T *allocate(std::size_t n) {
+    return static_cast<T *>(::operator new(n * sizeof(T), alignment));
+  }
+  void deallocate(T *p, std::size_t n) {
+    ::operator delete(p, n * sizeof(T), alignment);
+  }
+  template <typename U>
+  friend bool operator==(const aligned_allocator &,
+                         const aligned_allocator<U> &) {
+    return true;
+  }
+};
+
+template <std::size_t Rank>
+std::array<std::ptrdiff_t, Rank>
+row_major_strides(const std::array<std::size_t, Rank> &shape) {
+  std::array<std::ptrdiff_t, Rank> strides{};
+  std::ptrdiff_t stride = 1;
+  for (std::size_t d = Rank; d-- > 0;) {
+    strides[d] = stride;
+    stride *= static_cast<std::ptrdiff_t>(shape[d]);
+  }
+  return strides;
+}
+
+template <std::size_t Rank>
+std::size_t shape_numel(const std::array<std::size_t, Rank> &shape) {
+  std::size_t n = 1;
+  for (auto extent : shape) {
+    n *= extent;
+  }
+  return n;
+}
+
+// a python slice start:stop:step resolved against a length. negative
+// positions count from the back, nullopt is python's None and positions
+// outside the sequence are clamped
+struct slice_bounds {
+  std::ptrdiff_t start = 0;
+  std::ptrdiff_t step = 1;
+  std::size_t count = 0;
+};
+
+constexpr slice_bounds resolve_slice(std::size_t size,
+                                     std::optional<std::ptrdiff_t> start,
+                                     std::optional<std::ptrdiff_t> stop,
+                                     std::ptrdiff_t step) {
+  if (step == 0) {
+    throw std::runtime_error("slice: step must not be 0");
+  }
+  auto n = static_cast<std::ptrdiff_t>(size);
+  // a reversed slice may stop in front of the first element (-1)
+  std::ptrdiff_t lo = step > 0 ? 0 : -1;
+  std::ptrdiff_t hi = step > 0 ? n : n - 1;
+  auto resolve = [&](std::optional<std::ptrdiff_t> i, std::ptrdiff_t none) {
+    if (!i) {
+      return none;
+    }
+    return std::clamp(*i < 0 ? *i + n : *i, lo, hi);
+  };
+  slice_bounds bounds;
+  bounds.start = resolve(start, step > 0 ? lo : hi);
+  bounds.step = step;
+  std::ptrdiff_t end = resolve(stop, step > 0 ? hi : lo);
+  std::ptrdiff_t distance = step > 0 ? end - bounds.start : bounds.start - end;
+  std::ptrdiff_t stride = step > 0 ? step : -step;
+  if (distance > 0) {
+    bounds.count = static_cast<std::size_t>((distance + stride - 1) / stride);
+  } else {
+    bounds.start = 0;
+  }
+  return bounds;
+}
+} // namespace detail
+
+/*
+tensor_view<T, Rank> is a non-owning, mdspan-like view: a pointer, an extent
+and a stride (in elements) per axis. slicing, transposing and taking a row
+only produce a new view, no element is copied. iteration visits the elements
+in row-major order of the view, so every utils algorithm taking a container
+works on it. use tensor_view<const T, Rank> for read only access.
+*/
+template <typename T, std::size_t Rank>
+class tensor_view : public std::ranges::view_interface<tensor_view<T, Rank>> {
+  static_assert(Rank > 0, "tensor_view: Rank must be greater than 0");
+
+public:
+  using element_type = T;
+  using value_type = std::remove_cv_t<T>;
+  using extents_type = std::array<std::size_t, Rank>;
+  using strides_type = std::array<std::ptrdiff_t, Rank>;
+
+  // 多维计数器,最内层维度每走一步指针加一个stride,满了向外进位
+  class iterator {
+  public:
+    using iterator_concept = std::forward_iterator_tag;
+    using iterator_category = std::forward_iterator_tag;
+    using value_type = std::remove_cv_t<T>;
+    using reference = T &;
+    using difference_type = std::ptrdiff_t;
+
+    iterator() = default;
+    iterator(const tensor_view &view, std::size_t pos)
+        : _ptr(view._data), _shape(view._shape), _strides(view._strides),
+          _pos(pos) {}
+
+    T &operator*() const { return *_ptr; }
+    T *operator->() const { return _ptr; }
+
+    iterator &operator++() {
+      ++_pos;
+      _ptr += _strides[Rank - 1];
+      for (std::size_t d = Rank - 1; d > 0 && ++_index[d] == _shape[d]; --d) {
+        _ptr += _strides[d - 1] -
+                static_cast<std::ptrdiff_t>(_shape[d]) * _strides[d];
+        _index[d] = 0;
+      }
+      return *this;
+    }
+    iterator operator++(int) {
+      auto tmp = *this;
+      ++(*this);
+      return tmp;
+    }
+
+    // 只比较线性位置
+    friend bool operator==(const iterator &a, const iterator &b) {
+      return a._pos == b._pos;
+    }
+
+  private:
+    T *_ptr = nullptr;
+    extents_type _shape{};
+    strides_type _strides{};
+    extents_type _index{};
+    std::size_t _pos = 0;
+  };
+
+  tensor_view() = default;
+  tensor_view(T *data, const extents_type &shape)
+      : _data(data), _shape(shape),
+        _strides(detail::row_major_strides<Rank>(shape)) {}
+  tensor_view(T *data, const extents_type &shape, const strides_type &strides)
+      : _data(data), _shape(shape), _strides(strides) {}
+  // tensor_view<T> -> tensor_view<const T>
+  template <typename U>
+  requires(!std::same_as<U, T> && std::convertible_to<U *, T *>)
+      tensor_view(const tensor_view<U, Rank> &other)
+      : _data(other.data()), _shape(other.shape()), _strides(other.strides()) {
+  }
+
+  static constexpr std::size_t rank() { return Rank; }
+  T *data() const { return _data; }
+  const extents_type &shape() const { return _shape; }
+  const strides_type &strides() const { return _strides; }
+  std::size_t extent(std::size_t axis) const { return _shape[axis]; }
+  std::size_t size() const { return detail::shape_numel<Rank>(_shape); }
+  bool empty() const { return size() == 0; }
+
+  // 按行主序紧密排列,可以当成一段连续内存处理
+  bool is_contiguous() const {
+    std::ptrdiff_t expected = 1;
+    for (std::size_t d = Rank; d-- > 0;) {
+      if (_shape[d] != 1 && _strides[d] != expected) {
+        return false;
+      }
+      expected *= static_cast<std::ptrdiff_t>(_shape[d]);
+    }
+    return true;
+  }
+
+  iterator begin() const { return iterator(*this, 0); }
+  iterator end() const { return iterator(*this, size()); }
+
+  template <std::integral... I>
+  requires(sizeof...(I) == Rank) T &operator()(I... indices) const {
+    std::ptrdiff_t offset = 0;
+    std::size_t d = 0;
+    ((offset += static_cast<std::ptrdiff_t>(indices) * _strides[d++]), ...);
+    return _data[offset];
+  }
+
+  // t[i]: the element for Rank 1, otherwise the (Rank-1)-dimensional view of
+  // the i-th entry along the first axis
+  decltype(auto) operator[](std::size_t i) const {
+    T *first = _data + static_cast<std::ptrdiff_t>(i) * _strides[0];
+    if constexpr (Rank == 1) {
+      return *first;
+    } else {
+      typename tensor_view<T, Rank - 1>::extents_type shape;
+      typename tensor_view<T, Rank - 1>::strides_type strides;
+      std::copy(_shape.begin() + 1, _shape.end(), shape.begin());
+      std::copy(_strides.begin() + 1, _strides.end(), strides.begin());
+      return tensor_view<T, Rank - 1>(first, shape, strides);
+    }
+  }
+
+  // the sub-views along the first axis, e.g. the rows of a matrix
+  auto rows() const {
+    return std::views::iota(std::size_t(0), _shape[0]) |
+           std::views::transform(
+               [view = *this](std::size_t i) { return view[i]; });
+  }
+
+  // start:stop:step along one axis with python semantics, like utils::slice.
+  // a negative step walks the axis backwards through a negative stride
+  tensor_view slice(std::size_t axis, std::optional<std::ptrdiff_t> start,
+                    std::optional<std::ptrdiff_t> stop,
+                    std::ptrdiff_t step = 1) const {
+    if (axis >= Rank) {
+      throw std::runtime_error("tensor_view: axis out of range");
+    }
+    auto bounds = detail::resolve_slice(_shape[axis], start, stop, step);
+    tensor_view result = *this;
+    result._data += bounds.start * _strides[axis];
+    result._shape[axis] = bounds.count;
+    result._strides[axis] *= bounds.step;
+    return result;
+  }
+
+  // the axes reordered, result axis i is axis axes[i] of this view
+  tensor_view permute(const std::array<std::size_t, Rank> &axes) const {
+    tensor_view result = *this;
+    std::array<bool, Rank> seen{};
+    for (std::size_t d = 0; d < Rank; ++d) {
+      if (axes[d] >= Rank || seen[axes[d]]) {
+        throw std::runtime_error("tensor_view: axes must be a permutation");
+      }
+      seen[axes[d]] = true;
+      result._shape[d] = _shape[axes[d]];
+      result._strides[d] = _strides[axes[d]];
+    }
+    return result;
+  }
+
+  tensor_view transpose() const {
+    tensor_view result = *this;
+    std::reverse(result._shape.begin(), result._shape.end());
+    std::reverse(result._strides.begin(), result._strides.end());
+    return result;
+  }
+
+  // only a contiguous view can be reinterpreted with another shape
+  template <std::size_t N>
+  tensor_view<T, N> reshape(const std::array<std::size_t, N> &shape) const {
+    if (!is_contiguous()) {
+      throw std::runtime_error("tensor_view: reshape needs a contiguous view");
+    }
+    if (detail::shape_numel<N>(shape) != size()) {
+      throw std::runtime_error("tensor_view: reshape changes the size");
+    }
+    return tensor_view<T, N>(_data, shape);
+  }
+
+  // nested std::vector with the same shape, vector<vector<T>> for Rank 2
+  auto to_nested() const {
+    if constexpr (Rank == 1) {
+      return std::vector<value_type>(begin(), end());
+    } else {
+      std::vector<decltype((*this)[0].to_nested())> result;
+      result.reserve(_shape[0]);
+      for (std::size_t i = 0; i < _shape[0]; ++i) {
+        result.push_back((*this)[i].to_nested());
+      }
+      return result;
+    }
+  }
+
+private:
+  T *_data = nullptr;
+  extents_type _shape{};
+  strides_type _strides{};
+};
+
+/*
+tensor<T, Rank> owns one 64 byte aligned, row-major buffer. it is a
+contiguous range of its elements (so sum/prod/minmax/... take the SIMD
+paths) and forwards indexing, slicing and transposing to tensor_view.
+  utils::tensor<double, 2> m(rows, cols);
+  auto row_sums = utils::map([](auto r) { return utils::sum(r); }, m.rows());
+*/
+template <typename T, std::size_t Rank> class tensor {
+  static_assert(Rank > 0, "tensor: Rank must be greater than 0");
+
+public:
+  using value_type = T;
+  using extents_type = std::array<std::size_t, Rank>;
+  using strides_type = std::array<std::ptrdiff_t, Rank>;
+  using view_type = tensor_view<T, Rank>;
+  using const_view_type = tensor_view<const T, Rank>;
+
+  tensor() = default;
+  explicit tensor(const extents_type &shape, const T &fill = T())
+      : _shape(shape), _buffer(detail::shape_numel<Rank>(shape), fill) {}
+  template <std::integral... I>
+  requires(sizeof...(I) == Rank) explicit tensor(I... extents)
+      : tensor(extents_type{static_cast<std::size_t>(extents)...}) {}
+  // copies a (possibly strided) view into a dense tensor
+  template <typename U>
+  requires std::convertible_to<const U &, T>
+  explicit tensor(const tensor_view<U, Rank> &view)
+      : _shape(view.shape()), _buffer(view.begin(), view.end()) {}
+
+  static constexpr std::size_t rank() { return Rank; }
+  T *data() { return _buffer.data(); }
+  const T *data() const { return _buffer.data(); }
+  const extents_type &shape() const { return _shape; }
+  strides_type strides() const {
+    return detail::row_major_strides<Rank>(_shape);
+  }
+  std::size_t extent(std::size_t axis) const { return _shape[axis]; }
+  std::size_t size() const { return _buffer.size(); }
+  bool empty() const { return _buffer.empty(); }
+
+  T *begin() { return _buffer.data(); }
+  T *end() { return _buffer.data() + _buffer.size(); }
+  const T *begin() const { return _buffer.data(); }
+  const T *end() const { return _buffer.data() + _buffer.size(); }
+
+  view_type view() { return view_type(data(), _shape); }
+  const_view_type view() const { return const_view_type(data(), _shape); }
+  operator view_type() { return view(); }
+  operator const_view_type() const { return view(); }
+
+  template <std::integral... I>
+  requires(sizeof...(I) == Rank) T &operator()(I... indices) {
+    return view()(indices...);
+  }
+  template <std::integral... I>
+  requires(sizeof...(I) == Rank) const T &operator()(I... indices) const {
+    return view()(indices...);
+  }
+  decltype(auto) operator[](std::size_t i) { return view()[i]; }
+  decltype(auto) operator[](std::size_t i) const { return view()[i]; }
+
+  auto rows() { return view().rows(); }
+  auto rows() const { return view().rows(); }
+  view_type slice(std::size_t axis, std::optional<std::ptrdiff_t> start,
+                  std::optional<std::ptrdiff_t> stop, std::ptrdiff_t step = 1) {
+    return view().slice(axis, start, stop, step);
+  }
+  const_view_type slice(std::size_t axis, std::optional<std::ptrdiff_t> start,
+                        std::optional<std::ptrdiff_t> stop,
+                        std::ptrdiff_t step = 1) const {
+    return view().slice(axis, start, stop, step);
+  }
+  view_type permute(const std::array<std::size_t, Rank> &axes) {
+    return view().permute(axes);
+  }
+  const_view_type permute(const std::array<std::size_t, Rank> &axes) const {
+    return view().permute(axes);
+  }
+  view_type transpose() { return view().transpose(); }
+  const_view_type transpose() const { return view().transpose(); }
+  template <std::size_t N>
+  tensor_view<T, N> reshape(const std::array<std::size_t, N> &shape) {
+    return view().reshape(shape);
+  }
+  template <std::size_t N>
+  tensor_view<const T, N>
+  reshape(const std::array<std::size_t, N> &shape) const {
+    return view().reshape(shape);
+  }
+  auto to_nested() const { return view().to_nested(); }
+
+  friend bool operator==(const tensor &a, const tensor &b) {
+    return a._shape == b._shape && std::ranges::equal(a._buffer, b._buffer);
+  }
+
+private:
+  extents_type _shape{};
+  std::vector<T, detail::aligned_allocator<T>> _buffer;
+};
+
+template <typename T, std::size_t Rank>
+tensor(const tensor_view<T, Rank> &) -> tensor<std::remove_cv_t<T>, Rank>;
+
+namespace detail {
+template <typename C> constexpr std::size_t nesting_depth() {
+  if constexpr (std::ranges::range<C>) {
+    return 1 + nesting_depth<std::ranges::range_value_t<C>>();
+  } else {
+    return 0;
+  }
+}
+
+template <typename C> struct innermost_value {
+  using type = C;
+};
+template <std::ranges::range C> struct innermost_value<C> {
+  using type = typename innermost_value<std::ranges::range_value_t<C>>::type;
+};
+
+template <std::size_t D, std::size_t Rank, typename C>
+void nested_shape(const C &c, std::array<std::size_t, Rank> &shape) {
+  shape[D] = static_cast<std::size_t>(std::ranges::distance(c));
+  if constexpr (D + 1 < Rank) {
+    if (shape[D] > 0) {
+      nested_shape<D + 1>(*std::ranges::begin(c), shape);
+    }
+  }
+}
+
+template <std::size_t D, std::size_t Rank, typename C, typename T>
+void nested_copy(const C &c, const std::array<std::size_t, Rank> &shape,
+                 T *&out) {
+  if (static_cast<std::size_t>(std::ranges::distance(c)) != shape[D]) {
+    throw std::runtime_error("tensor: nested container is ragged");
+  }
+  for (const auto &val : c) {
+    if constexpr (D + 1 < Rank) {
+      nested_copy<D + 1>(val, shape, out);
+    } else {
+      *out++ = static_cast<T>(val);
+    }
+  }
+}
+
+// reduce a strided view one innermost row at a time, unit stride rows go
+// through the same SIMD kernels as contiguous containers
+template <reduce_op Op, typename T, std::size_t Rank>
+std::remove_cv_t<T> tensor_reduce(const tensor_view<T, Rank> &view) {
+  using V = std::remove_cv_t<T>;
+  constexpr V identity = Op == reduce_op::prod ? V(1) : V(0);
+  auto reduce_row = [](const T *row, std::size_t n, std::ptrdiff_t stride) {
+    if constexpr (SimdArithmetic<V>) {
+      if (stride == 1) {
+        return reduce_contiguous<Op>(row, n);
+      }
+    }
+    V acc = identity;
+    V comp = V(0);
+    for (std::size_t i = 0; i < n; ++i, row += stride) {
+      reduce_step<Op>(acc, comp, *row);
+    }
+    return acc;
+  };
+  if (view.is_contiguous()) {
+    return reduce_row(view.data(), view.size(), 1);
+  }
+  if constexpr (Rank == 1) {
+    return reduce_row(view.data(), view.extent(0), view.strides()[0]);
+  } else {
+    V acc = identity;
+    V comp = V(0);
+    for (std::size_t i = 0; i < view.extent(0); ++i) {
+      reduce_step<Op>(acc, comp, tensor_reduce<Op>(view[i]));
+    }
+    return acc;
+  }
+}
+} // namespace detail
+
+// dense tensor with the shape of a nested container, throws if it is ragged
+template <std::ranges::range C> auto to_tensor(const C &nested) {
+  using T = typename detail::innermost_value<C>::type;
+  constexpr std::size_t rank = detail::nesting_depth<C>();
+  std::array<std::size_t, rank> shape{};
+  detail::nested_shape<0>(nested, shape);
+  tensor<T, rank> result(shape);
+  T *out = result.data();
+  detail::nested_copy<0>(nested, shape, out);
+  return result;
+}
+
+template <ContainerWithArithmeticElement C>
+requires Tensor<C>
+typename std::remove_cvref_t<C>::value_type sum(C &&c) {
+  UTILS_PROBE(sum, c);
+  return detail::tensor_reduce<detail::reduce_op::sum>(
+      tensor_view<const typename std::remove_cvref_t<C>::value_type,
+                  std::remove_cvref_t<C>::rank()>(c));
+}
+
+template <ContainerWithArithmeticElement C>
+requires Tensor<C>
+typename std::remove_cvref_t<C>::value_type prod(C &&c) {
+  UTILS_PROBE(prod, c);
+  if (c.empty()) {
+    return 0;
+  }
+  return detail::tensor_reduce<detail::reduce_op::prod>(
+      tensor_view<const typename std::remove_cvref_t<C>::value_type,
+                  std::remove_cvref_t<C>::rank()>(c));
+}
+
+// number of elements of the tensor (for a plain container numel multiplies
+// the entries, i.e. treats it as a shape)
+template <ContainerWithArithmeticElement C>
+requires Tensor<C> std::size_t numel(C &&c) { return c.size(); }
+
+template <ContainerWithPrintableElement C>
+requires Tensor<C>
+inline std::string shape_to_string(C &&t) { return shape_to_string(t.shape()); }
+
+/*
+mapped_array<T> maps a binary file of T values into memory read only
+(mmap). pages are loaded on first touch and, being clean file pages, can be
+dropped by the kernel under memory pressure, so
+  utils::sum(utils::mapped_array<float>("data.bin"))
+reads the file once without copying it. the default sequential hint lets the
+kernel read ahead and free pages behind the scan. trailing bytes that do not
+form a whole T are ignored. on windows the file is not mapped but read into
+memory in full, use streamed_array there for files larger than memory.
+*/
+enum class access_pattern { normal, sequential, random };
+
+template <typename T>
+requires std::is_trivially_copyable_v<T>
+class mapped_array {
+public:
+  using value_type = T;
+  using iterator = const T *;
+  using const_iterator = const T *;
+
+  mapped_array() = default;
+  explicit mapped_array(const std::string &path,
+                        access_pattern hint = access_pattern::sequential) {
+#if defined(_WIN32)
+    // 没有mmap时退化成一次性读入,直接读进_fallback
+    std::FILE *file = std::fopen(path.c_str(), "rb");
+    if (file == nullptr) {
+      throw std::runtime_error("mapped_array: cannot open " + path);
+    }
+    long long bytes = -1;
+    if (_fseeki64(file, 0, SEEK_END) == 0) {
+      bytes = _ftelli64(file);
+    }
+    if (bytes < 0 || _fseeki64(file, 0, SEEK_SET) != 0) {
+      std::fclose(file);
+      throw std::runtime_error("mapped_array: cannot stat " + path);
+    }
+    _fallback.resize(static_cast<std::size_t>(bytes) / sizeof(T));
+    _size = std::fread(_fallback.data(), sizeof(T), _fallback.size(), file);
+    std::fclose(file);
+    _fallback.resize(_size);
+    _data = _fallback.data();
+    (void)hint;
+#else
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+      throw std::runtime_error("mapped_array: cannot open " + path + ": " +
+                               std::strerror(errno));
+    }
+    struct stat st;
+    if (::fstat(fd, &st) != 0) {
+      int err = errno;
+      ::close(fd);
+      throw std::runtime_error("mapped_array: cannot stat " + path + ": " +
+                               std::strerror(err));
+    }
+    _bytes = static_cast<std::size_t>(st.st_size);
+    _size = _bytes / sizeof(T);
+    if (_bytes > 0) {
+      void *addr = ::mmap(nullptr, _bytes, PROT_READ, MAP_PRIVATE, fd, 0);
+      if (addr == MAP_FAILED) {
+        int err = errno;
+        ::close(fd);
+        throw std::runtime_error("mapped_array: cannot map " + path + ": " +
+                                 std::strerror(err));
+      }
+      _data = static_cast<const T *>(addr);
+    }
+    // the mapping keeps the file alive
+    ::close(fd);
+    advise(hint);
+#endif
+  }
+
+  mapped_array(mapped_array &&other) noexcept { swap(other); }
+  mapped_array &operator=(mapped_array &&other) noexcept {
+    mapped_array(std::move(other)).swap(*this);
+    return *this;
+  }
+  mapped_array(const mapped_array &) = delete;
+  mapped_array &operator=(const mapped_array &) = delete;
+  ~mapped_array() {
+#if !defined(_WIN32)
+    if (_data != nullptr) {
+      ::munmap(const_cast<T *>(_data), _bytes);
+    }
+#endif
+  }
+
+  // change the read ahead behaviour of the kernel for later accesses
+  void advise(access_pattern hint) const {
+#if !defined(_WIN32)
+    if (_data == nullptr) {
+      return;
+    }
+    int advice = hint == access_pattern::sequential ? MADV_SEQUENTIAL
+                 : hint == access_pattern::random   ? MADV_RANDOM
+                                                    : MADV_NORMAL;
+    ::madvise(const_cast<T *>(_data), _bytes, advice);
+#else
+    (void)hint;
+#endif
+  }
+
+  const T *data() const { return _data; }
+  std::size_t size() const { return _size; }
+  bool empty() const { return _size == 0; }
+  const T *begin() const { return _data; }
+  const T *end() const { return _data + _size; }
+  const T &operator[](std::size_t i) const { return _data[i]; }
+
+  void swap(mapped_array &other) noexcept {
+    std::swap(_data, other._data);
+    std::swap(_size, other._size);
+    std::swap(_bytes, other._bytes);
+#if defined(_WIN32)
+    _fallback.swap(other._fallback);
+#endif
+  }
+
+private:
+  const T *_data = nullptr;
+  std::size_t _size = 0;
+  std::size_t _bytes = 0;
+#if defined(_WIN32)
+  std::vector<T> _fallback;
+#endif
+};
+
+/*
+streamed_array<T> reads a binary file of T values through a fixed size
+buffer, for files larger than memory or pipes. it is an input range of the
+values (every begin() starts a new pass from the start of the file), and
+sum/prod/minmax hand whole chunks to their SIMD kernels through
+for_each_chunk. only chunk_bytes of the file are resident at any time.
+a pipe or FIFO can not seek, so it allows a single pass and a second one
+throws. a moved-from streamed_array throws on begin()/for_each_chunk.
+*/
+template <typename T>
+requires std::is_trivially_copyable_v<T>
+class streamed_array {
+public:
+  using value_type = T;
+
+  class iterator {
+  public:
+    using iterator_concept = std::input_iterator_tag;
+    using value_type = T;
+    using difference_type = std::ptrdiff_t;
+
+    iterator() = default;
+    explicit iterator(const streamed_array *source) : _source(source) {
+      _count = _source->refill();
+    }
+
+    const T &operator*() const { return _source->_buffer[_pos]; }
+    iterator &operator++() {
+      if (++_pos == _count) {
+        _count = _source->refill();
+        _pos = 0;
+      }
+      return *this;
+    }
+    void operator++(int) { ++(*this); }
+
+    friend bool operator==(const iterator &it, std::default_sentinel_t) {
+      return it._count == 0;
+    }
+
+  private:
+    const streamed_array *_source = nullptr;
+    std::size_t _pos = 0;
+    std::size_t _count = 0;
+  };
+
+  explicit streamed_array(const std::string &path,
+                          std::size_t chunk_bytes = std::size_t(1) << 20)
+      : _file(std::fopen(path.c_str(), "rb")),
+        _buffer(std::max<std::size_t>(1, chunk_bytes / sizeof(T))) {
+    if (_file == nullptr) {
+      throw std::runtime_error("streamed_array: cannot open " + path + ": " +
+                               std::strerror(errno));
+    }
+  }
+  streamed_array(streamed_array &&other) noexcept
+      : _file(std::exchange(other._file, nullptr)),
+        _buffer(std::move(other._buffer)), _started(other._started) {}
+  streamed_array(const streamed_array &) = delete;
+  streamed_array &operator=(const streamed_array &) = delete;
+  ~streamed_array() {
+    if (_file != nullptr) {
+      std::fclose(_file);
+    }
+  }
+
+  iterator begin() const {
+    rewind();
+    return iterator(this);
+  }
+  std::default_sentinel_t end() const { return std::default_sentinel; }
+
+  // one pass over the file, f receives consecutive std::span<const T> chunks
+  template <typename F> void for_each_chunk(F &&f) const {
+    rewind();
+    for (std::size_t n = refill(); n > 0; n = refill()) {
+      f(std::span<const T>(_buffer.data(), n));
+    }
+  }
+
+private:
+  // the first pass reads from where the file was opened, so no seek is needed
+  // and pipes work; later passes seek back to the start
+  void rewind() const {
+    if (_file == nullptr) {
+      throw std::runtime_error("streamed_array: moved-from");
+    }
+    if (!_started) {
+      _started = true;
+      return;
+    }
+    std::clearerr(_file);
+    if (std::fseek(_file, 0, SEEK_SET) != 0) {
+      throw std::runtime_error(
+          "streamed_array: cannot rewind the file (a pipe allows one pass)");
+    }
+  }
+
+  // 读满一个chunk,文件末尾不足一个T的字节丢弃
+  std::size_t refill() const {
+    std::size_t n =
+        std::fread(_buffer.data(), sizeof(T), _buffer.size(), _file);
+    if (n == 0 && std::ferror(_file)) {
+      throw std::runtime_error("streamed_array: read error");
+    }
+    return n;
+  }
+
+  // reading does not change the values of the array, only the file position
+  // and the buffer contents
+  std::FILE *_file;
+  mutable std::vector<T> _buffer;
+  mutable bool _started = false;
+};
+
+namespace detail {
+// branchless compaction: always store, only advance the output on a match
+template <typename InputIt, typename T, typename Predicate>
+constexpr std::size_t compress_scalar(InputIt first, std::size_t n, T *out,
+                            Predicate &pred) {
+  std::size_t k = 0;
+  for (std::size_t i = 0; i < n; ++i, ++first) {
+    const auto &val = *first;
+    out[k] = val;
+    k += static_cast<bool>(pred(val));
+  }
+  return k;
+}
+
+#if UTILS_X86_DISPATCH
+// permutation table moving the selected 32-bit lanes of a 256-bit register to
+// the front. for 64-bit elements each lane is a pair of 32-bit lanes.
+template <std::size_t Lanes> struct compress_table {
+  static constexpr auto value = [] {
+    std::array<std::array<std::int32_t, 8>, (1u << Lanes)> table{};
+    constexpr std::size_t width = 8 / Lanes;
+    for (std::size_t mask = 0; mask < table.size(); ++mask) {
+      std::size_t k = 0;
+      for (std::size_t lane = 0; lane < Lanes; ++lane) {
+        if (mask & (1u << lane)) {
+          for (std::size_t w = 0; w < width; ++w) {
+            table[mask][k++] = static_cast<std::int32_t>(lane * width + w);
+          }
+        }
+      }
+    }
+    return table;
+  }();
+};
+
+template <typename T, std::size_t Lanes, typename Predicate>
+UTILS_ALWAYS_INLINE std::uint32_t predicate_mask(const T *data,
+                                                 Predicate &pred) {
+  std::uint32_t mask = 0;
+  for (std::size_t j = 0; j < Lanes; ++j) {
+    mask |= static_cast<std::uint32_t>(static_cast<bool>(pred(data[j]))) << j;
+  }
+  return mask;
+}
+
+// the full register is stored at out+k, callers guarantee room for n values
+template <typename T, typename Predicate>
+__attribute__((target("avx2,popcnt"))) std::size_t
+compress_avx2(const T *data, std::size_t n, T *out, Predicate &pred) {
+  constexpr std::size_t lanes = 32 / sizeof(T);
+  std::size_t i = 0;
+  std::size_t k = 0;
+  for (; i + lanes <= n; i += lanes) {
+    std::uint32_t mask = predicate_mask<T, lanes>(data + i, pred);
+    __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(data + i));
+    __m256i perm = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(
+        compress_table<lanes>::value[mask].data()));
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(out + k),
+                        _mm256_permutevar8x32_epi32(x, perm));
+    k += static_cast<std::size_t>(std::popcount(mask));
+  }
+  return k + compress_scalar(data + i, n - i, out + k, pred);
+}
+
+template <typename T, typename Predicate>
+__attribute__((target("avx512f,popcnt"))) std::size_t
+compress_avx512(const T *data, std::size_t n, T *out, Predicate &pred) {
+  constexpr std::size_t lanes = 64 / sizeof(T);
+  std::size_t i = 0;
+  std::size_t k = 0;
+  for (; i + lanes <= n; i += lanes) {
+    std::uint32_t mask = predicate_mask<T, lanes>(data + i, pred);
+    __m512i x = _mm512_loadu_si512(data + i);
+    // compress in register and store the whole vector, compressstoreu to
+    // memory is microcoded on some cores
+    if constexpr (sizeof(T) == 4) {
+      x = _mm512_maskz_compress_epi32(static_cast<__mmask16>(mask), x);
+    } else {
+      x = _mm512_maskz_compress_epi64(static_cast<__mmask8>(mask), x);
+    }
+    _mm512_storeu_si512(out + k, x);
+    k += static_cast<std::size_t>(std::popcount(mask));
+  }
+  return k + compress_scalar(data + i, n - i, out + k, pred);
+}
+#endif
+
+template <typename T, typename Predicate>
+std::size_t compress_contiguous(const T *data, std::size_t n, T *out,
+                                Predicate &pred) {
+#if UTILS_X86_DISPATCH
+  if constexpr (sizeof(T) == 4 || sizeof(T) == 8) {
+    switch (detect_simd_level()) {
+    case simd_level::avx512:
+      return compress_avx512(data, n, out, pred);
+    case simd_level::avx2:
+      return compress_avx2(data, n, out, pred);
+    default:
+      break;
+    }
+  }
+#endif
+  return compress_scalar(data, n, out, pred);
+}
+} // namespace detail
+
+/*
+select_into(c, pred, out) writes the elements of c that satisfy pred to the
+front of the caller provided buffer and returns how many were written. out
+must hold at least as many elements as c, the part behind the returned count
+is clobbered. reuse one buffer across batches to avoid allocations.
+*/
+template <ContainerWithArithmeticElement C, typename Predicate,
+          std::ranges::contiguous_range Out>
+requires std::ranges::sized_range<C> && std::ranges::sized_range<Out>
+constexpr std::size_t select_into(C &&c, Predicate &&pred, Out &&out) {
+  using ValueType = typename std::decay_t<decltype(*c.begin())>;
+  static_assert(
+      std::same_as<std::ranges::range_value_t<Out>, ValueType>,
+      "select_into: output element type must match the input element type");
+  std::size_t n = std::ranges::size(c);
+  if (std::ranges::size(out) < n) {
+    throw std::runtime_error(
+        "select_into: output buffer smaller than the input");
+  }
+  if constexpr (detail::ContiguousSimdRange<C>) {
+    if (!std::is_constant_evaluated()) {
+      return detail::compress_contiguous(std::ranges::data(c), n,
+                                         std::ranges::data(out), pred);
+    }
+  }
+  return detail::compress_scalar(std::ranges::begin(c), n,
+                                 std::ranges::data(out), pred);
+}
+
+// sized inputs allocate once (the input size) and trim the unused tail
+// without reallocating, use shrink_to_fit if the result is kept around
+template <ContainerWithArithmeticElement C, typename Predicate,
+          ResultAllocator A>
+constexpr auto select(C &&c, Predicate &&pred, const A &alloc) {
+  UTILS_PROBE(select, c);
+  using ValueType = typename std::decay_t<decltype(*c.begin())>;
+  detail::result_vector_t<ValueType, A> result(
+      detail::rebind_alloc<ValueType>(alloc));
+  if constexpr (std::ranges::sized_range<C>) {
+    result.resize(std::ranges::size(c));
+    result.resize(select_into(c, pred, result));
+  } else {
+    for (const auto &val : c) {
+      if (pred(val)) {
+        result.push_back(val);
+      }
+    }
+  }
+  return result;
+}
+
+template <ContainerWithArithmeticElement C, typename Predicate>
+constexpr auto select(C &&c, Predicate &&pred) {
+  UTILS_PROBE(select, c);
+  using ValueType = typename std::decay_t<decltype(*c.begin())>;
+  if constexpr (Generator<C>) {
+    // stays lazy like map
+    return detail::select_stream(std::forward<Predicate>(pred),
+                                 detail::stream_source(std::forward<C>(c)));
+  } else {
+    return select(std::forward<C>(c), std::forward<Predicate>(pred),
+                  std::allocator<ValueType>());
+  }
+}
+
+// order preserving parallel select: every chunk filters into a local buffer,
+// then the buffers are copied to their prefix-sum offsets in parallel
+template <ExecutionPolicy P, ContainerWithArithmeticElement C,
+          typename Predicate>
+requires detail::ParallelInput<C>
+auto select(P &&policy, C &&c, Predicate &&pred) {
+  UTILS_PROBE(select, c);
+  using ValueType = typename std::decay_t<decltype(*c.begin())>;
+  auto &pool = detail::pool_of(policy);
+  std::size_t n = std::ranges::size(c);
+  std::size_t chunk = detail::elementwise_chunk<ValueType>(n, pool.size());
+  std::size_t chunks = (n + chunk - 1) / chunk;
+  auto first = std::ranges::begin(c);
+  std::vector<std::vector<ValueType>> locals(chunks);
+  pool.parallel_for(chunks, [&](std::size_t i) {
+    auto lo = first + static_cast<std::ptrdiff_t>(i * chunk);
+    auto hi = first + static_cast<std::ptrdiff_t>(std::min(n, (i + 1) * chunk));
+    locals[i].resize(static_cast<std::size_t>(hi - lo));
+    locals[i].resize(
+        select_into(std::ranges::subrange(lo, hi), pred, locals[i]));
+  });
+  std::vector<std::size_t> offsets(chunks + 1, 0);
+  for (std::size_t i = 0; i < chunks; ++i) {
+    offsets[i + 1] = offsets[i] + locals[i].size();
+  }
+  std::vector<ValueType> result(offsets[chunks]);
+  pool.parallel_for(chunks, [&](std::size_t i) {
+    std::copy(locals[i].begin(), locals[i].end(),
+              result.begin() + static_cast<std::ptrdiff_t>(offsets[i]));
+  });
+  return result;
+}
+
+namespace detail {
+// number of values start, start + step, ... before end, step may be negative
+template <Arithmetic T> constexpr size_t range_count(T start, T end, T step) {
+  if (step == T(0)) {
+    throw std::runtime_error("range: step must not be 0");
+  }
+  if (step > T(0) ? !(start < end) : !(end < start)) {
+    return 0;
+  }
+  if constexpr (std::is_floating_point_v<T>) {
+    // the count must fit size_t, casting a larger or infinite value is UB
+    T count = std::ceil((end - start) / step);
+    constexpr T limit = T(2) * T(std::numeric_limits<size_t>::max() / 2 + 1);
+    if (!std::isfinite(count) || !(count < limit)) {
+      throw std::length_error("range: too many elements");
+    }
+    return static_cast<size_t>(count);
+  } else {
+    // the distance can exceed T (e.g. INT_MIN..INT_MAX), count in uint64_t
+    uint64_t lo = static_cast<uint64_t>(step > T(0) ? start : end);
+    uint64_t hi = static_cast<uint64_t>(step > T(0) ? end : start);
+    uint64_t distance = hi - lo;
+    uint64_t stride = step > T(0) ? static_cast<uint64_t>(step)
+                                  : uint64_t(0) - static_cast<uint64_t>(step);
+    return static_cast<size_t>(distance / stride + (distance % stride != 0));
+  }
+}
+} // namespace detail
+
+/*
+range_view: the arithmetic progression start, start + step, ... before end.
+nothing is stored, element i is computed as start + i * step (so floating
+point steps do not drift), size() is O(1) and step may be negative.
+  utils::range(0, 10, 3)     => {0, 3, 6, 9}
+  utils::range(5, 0, -2)     => {5, 3, 1}
+  utils::range(0.0, 1.0, .1) => 10 values, the last one 0.9
+split(parts) cuts it into contiguous sub-ranges for parallel loops, and
+sum() uses the closed form n * start + step * n * (n - 1) / 2.
+*/
+template <typename T>
+class range_view : public std::ranges::view_interface<range_view<T>> {
+public:
+  class iterator {
+  public:
+    using iterator_concept = std::random_access_iterator_tag;
+    using iterator_category = std::input_iterator_tag;
+    using value_type = T;
+    using difference_type = std::ptrdiff_t;
+
+    constexpr iterator() = default;
+    constexpr iterator(T start, T step, difference_type index)
+        : _start(start), _step(step), _index(index) {}
+
+    constexpr T operator*() const { return value(_index); }
+    constexpr T operator[](difference_type n) const {
+      return value(_index + n);
+    }
+
+    constexpr iterator &operator++() {
+      ++_index;
+      return *this;
+    }
+    constexpr iterator operator++(int) {
+      auto tmp = *this;
+      ++_index;
+      return tmp;
+    }
+    constexpr iterator &operator--() {
+      --_index;
+      return *this;
+    }
+    constexpr iterator operator--(int) {
+      auto tmp = *this;
+      --_index;
+      return tmp;
+    }
+    constexpr iterator &operator+=(difference_type n) {
+      _index += n;
+      return *this;
+    }
+    constexpr iterator &operator-=(difference_type n) {
+      _index -= n;
+      return *this;
+    }
+
+    friend constexpr bool operator==(const iterator &a, const iterator &b) {
+      return a._index == b._index;
+    }
+    friend constexpr auto operator<=>(const iterator &a, const iterator &b) {
+      return a._index <=> b._index;
+    }
+    friend constexpr iterator operator+(iterator it, difference_type n) {
+      return it += n;
+    }
+    friend constexpr iterator operator+(difference_type n, iterator it) {
+      return it += n;
+    }
+    friend constexpr iterator operator-(iterator it, difference_type n) {
+      return it -= n;
+    }
+    friend constexpr difference_type operator-(const iterator &a,
+                                               const iterator &b) {
+      return a._index - b._index;
+    }
+
+  private:
+    constexpr T value(difference_type i) const {
+      if constexpr (std::is_floating_point_v<T>) {
+        return static_cast<T>(_start + static_cast<T>(i) * _step);
+      } else {
+        // i * step can exceed T even when the element fits (e.g. INT_MIN..
+        // INT_MAX), compute in uint64_t as range_count does
+        return static_cast<T>(static_cast<uint64_t>(_start) +
+                              static_cast<uint64_t>(i) *
+                                  static_cast<uint64_t>(_step));
+      }
+    }
+
+    T _start = T(0);
+    T _step = T(1);
+    difference_type _index = 0;
+  };
+
+  constexpr range_view() = default;
+  constexpr range_view(T start, T end, T step = T(1))
+      : _start(start), _step(step),
+        _count(detail::range_count(start, end, step)) {}
+
+  constexpr iterator begin() const { return iterator(_start, _step, 0); }
+  constexpr iterator end() const {
+    return iterator(_start, _step, static_cast<std::ptrdiff_t>(_count));
+  }
+  constexpr size_t size() const { return _count; }
+  constexpr T operator[](size_t i) const {
+    return begin()[static_cast<std::ptrdiff_t>(i)];
+  }
+  constexpr T start() const { return _start; }
+  constexpr T step() const { return _step; }
+
+  // elements [first, last) as a range_view of their own
+  constexpr range_view subrange(size_t first, size_t last) const {
+    last = std::min(last, _count);
+    first = std::min(first, last);
+    range_view result;
+    result._start = (*this)[first];
+    result._step = _step;
+    result._count = last - first;
+    return result;
+  }
+
+  // at most parts contiguous, non-empty pieces whose sizes differ by at most 1
+  std::vector<range_view> split(size_t parts) const {
+    std::vector<range_view> result;
+    parts = std::min(parts, _count);
+    result.reserve(parts);
+    for (size_t i = 0; i < parts; ++i) {
+      result.push_back(subrange(_count * i / parts, _count * (i + 1) / parts));
+    }
+    return result;
+  }
+
+  constexpr T sum() const {
+    if constexpr (std::is_floating_point_v<T>) {
+      T n = static_cast<T>(_count);
+      return n * _start + _step * (n * (n - T(1)) / T(2));
+    } else {
+      // modulo 2^64, so the result wraps exactly like adding up the elements
+      uint64_t n = _count;
+      uint64_t triangle = n % 2 == 0 ? n / 2 * (n - 1) : (n - 1) / 2 * n;
+      return static_cast<T>(n * static_cast<uint64_t>(_start) +
+                            triangle * static_cast<uint64_t>(_step));
+    }
+  }
+
+private:
+  T _start = T(0);
+  T _step = T(1);
+  size_t _count = 0;
+};
+
+template <Arithmetic T, ResultAllocator A>
+constexpr auto range(T start, T end, T step, const A &alloc) {
+  range_view<T> values(start, end, step);
+  detail::result_vector_t<T, A> result(detail::rebind_alloc<T>(alloc));
+  // the iterators are input iterators to std::vector, fill by index instead
+  result.resize(values.size());
+  for (size_t i = 0; i < result.size(); ++i) {
+    result[i] = values[i];
+  }
+  return result;
+}
+
+// lazy, use range(...) | to_vector() or the allocator overload for a vector
+template <Arithmetic T> constexpr auto range(T start, T end, T step = 1) {
+  return range_view<T>(start, end, step);
+}
+
+/*
+range<start, end, step>() is the compile time form: the length is known from
+the template arguments, so the result is a std::array that can initialize a
+constexpr table, e.g.
+  constexpr auto squares = utils::map_array([](int x) { return x * x; },
+                                            utils::range<0, 256>());
+*/
+template <auto Start, auto End, auto Step = 1>
+requires Arithmetic<decltype(Start)> && Arithmetic<decltype(End)> &&
+    Arithmetic<decltype(Step)>
+consteval auto range() {
+  using T = std::common_type_t<decltype(Start), decltype(End), decltype(Step)>;
+  constexpr range_view<T> values(Start, End, Step);
+  std::array<T, values.size()> result{};
+  std::copy(values.begin(), values.end(), result.begin());
+  return result;
+}
+
+/*
+slice_view: a lazy, strided window of a random access range, with python's
+start:stop:step semantics (see utils::slice). elements are read from the
+underlying storage on access, nothing is copied.
+*/
+template <std::ranges::view V>
+requires std::ranges::random_access_range<V> && std::ranges::sized_range<V>
+class slice_view : public std::ranges::view_interface<slice_view<V>> {
+public:
+  template <bool Const> class slice_iterator {
+  public:
+    using Base = detail::maybe_const_t<Const, V>;
+    using iterator_concept = std::random_access_iterator_tag;
+    using value_type = std::ranges::range_value_t<Base>;
+    using reference = std::ranges::range_reference_t<Base>;
+    using difference_type = std::ranges::range_difference_t<Base>;
+
+    constexpr slice_iterator() = default;
+    constexpr slice_iterator(std::ranges::iterator_t<Base> first,
+                             difference_type index, difference_type step)
+        : _first(std::move(first)), _index(index), _step(step) {}
+    constexpr slice_iterator(slice_iterator<!Const> other) requires Const &&
+        std::convertible_to<std::ranges::iterator_t<V>,
+                            std::ranges::iterator_t<const V>>
+        : _first(std::move(other._first)), _index(other._index),
+          _step(other._step) {}
+
+    constexpr reference operator*() const { return _first[_index * _step]; }
+    constexpr reference operator[](difference_type n) const {
+      return _first[(_index + n) * _step];
+    }
+
+    constexpr slice_iterator &operator++() {
+      ++_index;
+      return *this;
+    }
+    constexpr slice_iterator operator++(int) {
+      auto tmp = *this;
+      ++_index;
+      return tmp;
+    }
+    constexpr slice_iterator &operator--() {
+      --_index;
+      return *this;
+    }
+    constexpr slice_iterator operator--(int) {
+      auto tmp = *this;
+      --_index;
+      return tmp;
+    }
+    constexpr slice_iterator &operator+=(difference_type n) {
+      _index += n;
+      return *this;
+    }
+    constexpr slice_iterator &operator-=(difference_type n) {
+      _index -= n;
+      return *this;
+    }
+
+    friend constexpr bool operator==(const slice_iterator &a,
+                                     const slice_iterator &b) {
+      return a._index == b._index;
+    }
+    friend constexpr auto operator<=>(const slice_iterator &a,
+                                      const slice_iterator &b) {
+      return a._index <=> b._index;
+    }
+    friend constexpr slice_iterator operator+(slice_iterator it,
+                                              difference_type n) {
+      return it += n;
+    }
+    friend constexpr slice_iterator operator+(difference_type n,
+                                              slice_iterator it) {
+      return it += n;
+    }
+    friend constexpr slice_iterator operator-(slice_iterator it,
+                                              difference_type n) {
+      return it -= n;
+    }
+    friend constexpr difference_type operator-(const slice_iterator &a,
+                                               const slice_iterator &b) {
+      return a._index - b._index;
+    }
+
+  private:
+    friend class slice_view;
+    std::ranges::iterator_t<Base> _first;
+    difference_type _index = 0;
+    difference_type _step = 1;
+  };
+
+  slice_view() = default;
+  constexpr slice_view(V base, std::optional<std::ptrdiff_t> start,
+                       std::optional<std::ptrdiff_t> stop,
+                       std::ptrdiff_t step = 1)
+      : _base(std::move(base)) {
+    _bounds = detail::resolve_slice(std::ranges::size(_base), start, stop,
+                                    step);
+  }
+
+  constexpr auto begin() { return make_iterator<false>(_base, 0); }
+  constexpr auto begin() const
+      requires std::ranges::random_access_range<const V> {
+    return make_iterator<true>(_base, 0);
+  }
+  constexpr auto end() { return make_iterator<false>(_base, _bounds.count); }
+  constexpr auto end() const
+      requires std::ranges::random_access_range<const V> {
+    return make_iterator<true>(_base, _bounds.count);
+  }
+  constexpr size_t size() const { return _bounds.count; }
+
+  // unit stride slices of contiguous storage are one span, which sum, prod and
+  // minmax hand to their SIMD kernels. any other stride is passed on as a
+  // single strided range (gathering it into a buffer first measured slower)
+  template <typename F>
+  requires std::ranges::contiguous_range<const V> &&
+      detail::SimdArithmetic<std::ranges::range_value_t<const V>>
+  constexpr void for_each_chunk(F &&f) const {
+    using T = std::ranges::range_value_t<const V>;
+    if (_bounds.step != 1) {
+      f(std::ranges::subrange(begin(), end()));
+    } else if (_bounds.count > 0) {
+      f(std::span<const T>(std::ranges::data(_base) + _bounds.start,
+                           _bounds.count));
+    }
+  }
+
+private:
+  template <bool Const, typename Base>
+  constexpr auto make_iterator(Base &base, size_t index) const {
+    using difference_type = std::ranges::range_difference_t<Base>;
+    return slice_iterator<Const>(
+        std::ranges::begin(base) + static_cast<difference_type>(_bounds.start),
+        static_cast<difference_type>(index),
+        static_cast<difference_type>(_bounds.step));
+  }
+
+  V _base = V();
+  detail::slice_bounds _bounds;
+};
+
+template <typename R>
+slice_view(R &&, std::optional<std::ptrdiff_t>, std::optional<std::ptrdiff_t>,
+           std::ptrdiff_t) -> slice_view<std::views::all_t<R>>;
+template <typename R>
+slice_view(R &&, std::optional<std::ptrdiff_t>, std::optional<std::ptrdiff_t>)
+    -> slice_view<std::views::all_t<R>>;
+
+template <ContainerWithArithmeticElement C, ResultAllocator A>
+constexpr auto slice(C &&c, std::optional<std::ptrdiff_t> start,
+                     std::optional<std::ptrdiff_t> stop, std::ptrdiff_t step,
+                     const A &alloc) {
+  using ValueType = typename std::decay_t<decltype(*c.begin())>;
+  slice_view view(std::views::all(c), start, stop, step);
+  detail::result_vector_t<ValueType, A> result(
+      detail::rebind_alloc<ValueType>(alloc));
+  result.resize(view.size());
+  std::ranges::copy(view, result.begin());
+  return result;
+}
+
+/*
+slice(c, start, stop, step) selects c[start:stop:step] the way python does:
+negative positions count from the back, std::nullopt stands for an omitted
+position and a negative step walks backwards. the result is a view into c,
+nothing is copied, and it can be passed straight to sum/map/select.
+  utils::slice(v, 1, -1)                     => v[1:-1]
+  utils::slice(v, std::nullopt, std::nullopt, -1) => v[::-1]
+Axis slices nested containers and tensors along a deeper axis, e.g. every
+other column of a matrix is slice<1>(m, 0, std::nullopt, 2). rows are not
+copied, each one is sliced lazily. pass an allocator (see utils::map) to
+copy the selected elements into a vector instead.
+*/
+template <std::size_t Axis = 0, std::ranges::viewable_range C>
+constexpr auto slice(C &&c, std::optional<std::ptrdiff_t> start,
+                     std::optional<std::ptrdiff_t> stop,
+                     std::ptrdiff_t step = 1) {
+  if constexpr (Tensor<C>) {
+    static_assert(std::is_lvalue_reference_v<C> ||
+                      std::ranges::view<std::remove_cvref_t<C>>,
+                  "slice: the tensor would be destroyed before its slice");
+    return c.slice(Axis, start, stop, step);
+  } else if constexpr (Axis == 0) {
+    return slice_view(std::forward<C>(c), start, stop, step);
+  } else {
+    return std::views::transform(
+        std::views::all(std::forward<C>(c)), [=](auto &&row) {
+          return utils::slice<Axis - 1>(std::forward<decltype(row)>(row), start,
+                                        stop, step);
+        });
+  }
+}
+
+namespace detail {
+// turns a callable taking a range into something usable after `|`
+template <typename F> struct pipe_closure {
+  F f;
+  template <std::ranges::viewable_range R>
+  friend auto operator|(R &&r, const pipe_closure &closure) {
+    return closure.f(std::forward<R>(r));
+  }
+};
+
+template <typename F> pipe_closure(F) -> pipe_closure<F>;
+
+} // namespace detail
+
+/*
+lazy counterparts of utils::map/select/slice/range. they return std::ranges
+views, so a chain like
+  utils::sum(c | utils::views::select(p) | utils::views::map(f))
+runs as one fused pass without intermediate vectors. utils::to_vector
+materializes a view when a container is needed.
+*/
+namespace views {
+template <typename F> auto map(F &&f) {
+  return std::views::transform(std::forward<F>(f));
+}
+
+template <typename F, std::ranges::viewable_range C> auto map(F &&f, C &&c) {
+  return std::views::transform(std::forward<C>(c), std::forward<F>(f));
+}
+
+template <typename Predicate> auto select(Predicate &&pred) {
+  return std::views::filter(std::forward<Predicate>(pred));
+}
+
+template <std::ranges::viewable_range C, typename Predicate>
+auto select(C &&c, Predicate &&pred) {
+  return std::views::filter(std::forward<C>(c), std::forward<Predicate>(pred));
+}
+
+inline auto slice(std::optional<std::ptrdiff_t> start,
+                  std::optional<std::ptrdiff_t> stop, std::ptrdiff_t step = 1) {
+  return detail::pipe_closure{[=]<typename C>(C &&c) {
+    return slice_view(std::forward<C>(c), start, stop, step);
+  }};
+}
+
+template <std::ranges::viewable_range C>
+auto slice(C &&c, std::optional<std::ptrdiff_t> start,
+           std::optional<std::ptrdiff_t> stop, std::ptrdiff_t step = 1) {
+  return slice_view(std::forward<C>(c), start, stop, step);
+}
+
+inline auto enumerate(uint64_t start = 0, uint64_t step = 1) {
+  return detail::pipe_closure{[=]<typename C>(C &&c) {
+    return utils::enumerate(std::forward<C>(c), start, step);
+  }};
+}
+
+template <Arithmetic T> constexpr auto range(T start, T end, T step = 1) {
+  return range_view<T>(start, end, step);
+}
+} // namespace views
+
+template <std::ranges::input_range R, ResultAllocator A>
+auto to_vector(R &&r, const A &alloc) {
+  using ValueType = std::ranges::range_value_t<R>;
+  detail::result_vector_t<ValueType, A> result(
+      detail::rebind_alloc<ValueType>(alloc));
+  if constexpr (std::ranges::sized_range<R>) {
+    result.reserve(std::ranges::size(r));
+  }
+  for (auto &&val : r) {
+    result.push_back(std::forward<decltype(val)>(val));
+  }
+  return result;
+}
+
+template <std::ranges::input_range R> auto to_vector(R &&r) {
+  return to_vector(std::forward<R>(r),
+                   std::allocator<std::ranges::range_value_t<R>>());
+}
+
+inline auto to_vector() {
+  return detail::pipe_closure{
+      []<typename R>(R &&r) { return to_vector(std::forward<R>(r)); }};
+}
+
+/*
+tolerance for approx_equals: two values match when they are within
+`absolute`, within `relative` times the larger magnitude, or at most `ulps`
+representable values apart. NaN never matches.
+  utils::approx_equals(a, b, {.relative = 1e-6})
+*/
+struct tolerance {
+  double relative = 0;
+  double absolute = 0;
+  std::uint64_t ulps = 4;
+};
+
+namespace detail {
+template <typename T>
+using lane_int_t = std::conditional_t<
+    sizeof(T) == 1, std::int8_t,
+    std::conditional_t<sizeof(T) == 2, std::int16_t,
+                       std::conditional_t<sizeof(T) == 4, std::int32_t,
+                                          std::int64_t>>>;
+
+template <typename M> UTILS_ALWAYS_INLINE bool any_lane(const M &mask) {
+  std::uint64_t words[sizeof(M) / 8];
+  std::memcpy(words, &mask, sizeof(M));
+  std::uint64_t any = 0;
+  for (auto w : words) {
+    any |= w;
+  }
+  return any != 0;
+}
+
+// floating point bits mapped to integers that are ordered like the values,
+// so the ULP distance of two values is the difference of their keys
+template <typename T> constexpr lane_int_t<T> ulp_key(T x) {
+  auto bits = std::bit_cast<lane_int_t<T>>(x);
+  using U = std::make_unsigned_t<lane_int_t<T>>;
+  return bits < 0 ? static_cast<lane_int_t<T>>(
+                        U(std::numeric_limits<lane_int_t<T>>::min()) - U(bits))
+                  : bits;
+}
+
+template <typename T> struct approx_params {
+  T absolute;
+  T relative;
+  std::make_unsigned_t<lane_int_t<T>> ulps;
+
+  explicit approx_params(const tolerance &tol)
+      : absolute(static_cast<T>(tol.absolute)),
+        relative(static_cast<T>(tol.relative)),
+        ulps(static_cast<std::make_unsigned_t<lane_int_t<T>>>(std::min<
+             std::uint64_t>(
+            tol.ulps,
+            std::numeric_limits<std::make_unsigned_t<lane_int_t<T>>>::max()))) {
+  }
+};
+
+template <typename T>
+bool approx_match(T a, T b, const approx_params<T> &tol) {
+  using U = std::make_unsigned_t<lane_int_t<T>>;
+  if (a != a || b != b) {
+    return false;
+  }
+  T diff = std::abs(a - b);
+  auto ka = ulp_key(a);
+  auto kb = ulp_key(b);
+  U distance = ka > kb ? U(ka) - U(kb) : U(kb) - U(ka);
+  return diff <= tol.absolute ||
+         diff <= tol.relative * std::max(std::abs(a), std::abs(b)) ||
+         distance <= tol.ulps;
+}
+
+/*
+index of the first position where a and b differ (Approx: are not within the
+tolerance), n if there is none. `unroll` vectors are compared branch free per
+step, only the block holding the first difference is searched element by
+element.
+*/
+template <bool Approx, typename T, std::size_t Bytes>
+UTILS_ALWAYS_INLINE std::size_t mismatch_kernel(const T *a, const T *b,
+                                                std::size_t n,
+                                                const approx_params<T> *tol) {
+  constexpr std::size_t unroll = 4;
+  std::size_t i = 0;
+#if defined(__GNUC__)
+  typedef T vec __attribute__((vector_size(Bytes)));
+  typedef lane_int_t<T> ivec __attribute__((vector_size(Bytes)));
+  typedef std::make_unsigned_t<lane_int_t<T>> uvec
+      __attribute__((vector_size(Bytes)));
+  constexpr std::size_t lanes = Bytes / sizeof(T);
+  for (; i + unroll * lanes <= n; i += unroll * lanes) {
+    ivec bad{};
+    for (std::size_t u = 0; u < unroll; ++u) {
+      vec x, y;
+      std::memcpy(&x, a + i + u * lanes, Bytes);
+      std::memcpy(&y, b + i + u * lanes, Bytes);
+      if constexpr (!Approx) {
+        bad |= x != y;
+      } else {
+        vec diff = x - y;
+        diff = diff < 0 ? -diff : diff;
+        vec ax = x < 0 ? -x : x;
+        vec ay = y < 0 ? -y : y;
+        vec mag = ax < ay ? ay : ax;
+        ivec kx, ky;
+        std::memcpy(&kx, &x, Bytes);
+        std::memcpy(&ky, &y, Bytes);
+        constexpr auto lowest = std::numeric_limits<lane_int_t<T>>::min();
+        kx = kx < 0 ? (ivec)((uvec{} + lowest) - (uvec)kx) : kx;
+        ky = ky < 0 ? (ivec)((uvec{} + lowest) - (uvec)ky) : ky;
+        uvec distance = kx > ky ? (uvec)kx - (uvec)ky : (uvec)ky - (uvec)kx;
+        ivec ok = (diff <= tol->absolute) | (diff <= tol->relative * mag) |
+                  (ivec)(distance <= tol->ulps);
+        bad |= ~(ok & (x == x) & (y == y));
+      }
+    }
+    if (any_lane(bad)) {
+      break;
+    }
+  }
+#endif
+  for (; i < n; ++i) {
+    if constexpr (!Approx) {
+      if (!(a[i] == b[i])) {
+        return i;
+      }
+    } else {
+      if (!approx_match(a[i], b[i], *tol)) {
+        return i;
+      }
+    }
+  }
+  return n;
+}
+
+#if UTILS_X86_DISPATCH
+template <bool Approx, typename T>
+__attribute__((target("avx2"))) std::size_t
+mismatch_avx2(const T *a, const T *b, std::size_t n,
+              const approx_params<T> *tol) {
+  return mismatch_kernel<Approx, T, 32>(a, b, n, tol);
+}
+
+template <bool Approx, typename T>
+__attribute__((target("avx512f"))) std::size_t
+mismatch_avx512(const T *a, const T *b, std::size_t n,
+                const approx_params<T> *tol) {
+  return mismatch_kernel<Approx, T, 64>(a, b, n, tol);
+}
+#endif
+
+template <bool Approx, typename T>
+std::size_t mismatch_contiguous(const T *a, const T *b, std::size_t n,
+                                const approx_params<T> *tol = nullptr) {
+#if UTILS_X86_DISPATCH
+  switch (detect_simd_level()) {
+  case simd_level::avx512:
+    return mismatch_avx512<Approx>(a, b, n, tol);
+  case simd_level::avx2:
+    return mismatch_avx2<Approx>(a, b, n, tol);
+  default:
+    break;
+  }
+#endif
+  return mismatch_kernel<Approx, T, 16>(a, b, n, tol);
+}
+
+template <typename C1, typename C2>
+concept SameContiguousSimd =
+    ContiguousSimdRange<C1> && ContiguousSimdRange<C2> &&
+    std::same_as<std::ranges::range_value_t<C1>,
+                 std::ranges::range_value_t<C2>>;
+} // namespace detail
+
+/*
+mismatch(c1,c2) is the index of the first position where c1 and c2 differ.
+when one is a prefix of the other it is the length of the shorter one, so
+for equally long ranges mismatch == size means equal.
+*/
+template <std::ranges::input_range C1, std::ranges::input_range C2>
+constexpr std::size_t mismatch(C1 &&c1, C2 &&c2) {
+  if constexpr (detail::SameContiguousSimd<C1, C2>) {
+    if (!std::is_constant_evaluated()) {
+      using T = std::ranges::range_value_t<C1>;
+      return detail::mismatch_contiguous<false, T>(
+          std::ranges::data(c1), std::ranges::data(c2),
+          std::min<std::size_t>(std::ranges::size(c1), std::ranges::size(c2)));
+    }
+  }
+  std::size_t i = 0;
+  auto it1 = std::ranges::begin(c1);
+  auto it2 = std::ranges::begin(c2);
+  for (; it1 != std::ranges::end(c1) && it2 != std::ranges::end(c2);
+       ++it1, ++it2, ++i) {
+    if (!(*it1 == *it2)) {
+      break;
+    }
+  }
+  return i;
+}
+
+// the first position where c1 and c2 are not within the tolerance
+template <std::ranges::input_range C1, std::ranges::input_range C2>
+requires std::floating_point<std::ranges::range_value_t<C1>> &&
+    std::floating_point<std::ranges::range_value_t<C2>>
+std::size_t mismatch(C1 &&c1, C2 &&c2, const tolerance &tol) {
+  using T = std::common_type_t<std::ranges::range_value_t<C1>,
+                               std::ranges::range_value_t<C2>>;
+  detail::approx_params<T> params(tol);
+  if constexpr (detail::SameContiguousSimd<C1, C2>) {
+    return detail::mismatch_contiguous<true, T>(
+        std::ranges::data(c1), std::ranges::data(c2),
+        std::min<std::size_t>(std::ranges::size(c1), std::ranges::size(c2)),
+        &params);
+  } else {
+    std::size_t i = 0;
+    auto it1 = std::ranges::begin(c1);
+    auto it2 = std::ranges::begin(c2);
+    for (; it1 != std::ranges::end(c1) && it2 != std::ranges::end(c2);
+         ++it1, ++it2, ++i) {
+      if (!detail::approx_match<T>(*it1, *it2, params)) {
+        break;
+      }
+    }
+    return i;
+  }
+}
+
+template <ContainerWithArithmeticElement C1, ContainerWithArithmeticElement C2>
+constexpr bool equals(C1 &&c1, C2 &&c2) {
+  UTILS_PROBE(equals, c1);
+  if constexpr (RangeView<C1> && RangeView<C2> &&
+                std::same_as<std::ranges::range_value_t<C1>,
+                             std::ranges::range_value_t<C2>>) {
+    // two progressions, compare start/step instead of every element
+    std::size_t n = c1.size();
+    if (n != c2.size()) {
+      return false;
+    }
+    if (n == 0 || (c1.start() == c2.start() &&
+                   (n == 1 || c1.step() == c2.step()))) {
+      return true;
+    }
+    if constexpr (std::is_integral_v<std::ranges::range_value_t<C1>>) {
+      return false;
+    }
+  }
+  if constexpr (std::ranges::sized_range<C1> && std::ranges::sized_range<C2>) {
+    std::size_t n = std::ranges::size(c1);
+    if (n != static_cast<std::size_t>(std::ranges::size(c2))) {
+      return false;
+    }
+    if constexpr (detail::SameContiguousSimd<C1, C2> &&
+                  std::is_integral_v<std::ranges::range_value_t<C1>>) {
+      // integers are equal exactly when their bytes are
+      if (!std::is_constant_evaluated()) {
+        return n == 0 ||
+               std::memcmp(std::ranges::data(c1), std::ranges::data(c2),
+                           n * sizeof(std::ranges::range_value_t<C1>)) == 0;
+      }
+    }
+    return utils::mismatch(c1, c2) == n;
+  } else {
+    auto it1 = std::ranges::begin(c1);
+    auto it2 = std::ranges::begin(c2);
+    for (; it1 != std::ranges::end(c1) && it2 != std::ranges::end(c2);
+         ++it1, ++it2) {
+      if (!(*it1 == *it2)) {
+        return false;
+      }
+    }
+    return it1 == std::ranges::end(c1) && it2 == std::ranges::end(c2);
+  }
+}
+
+// equal length and every pair of elements within the tolerance
+template <ContainerWithArithmeticElement C1, ContainerWithArithmeticElement C2>
+requires std::floating_point<std::ranges::range_value_t<C1>> &&
+    std::floating_point<std::ranges::range_value_t<C2>>
+bool approx_equals(C1 &&c1, C2 &&c2, const tolerance &tol = {}) {
+  if constexpr (std::ranges::sized_range<C1> && std::ranges::sized_range<C2>) {
+    std::size_t n = std::ranges::size(c1);
+    return n == static_cast<std::size_t>(std::ranges::size(c2)) &&
+           utils::mismatch(c1, c2, tol) == n;
+  } else {
+    // one pass only, input ranges such as generators cannot be walked twice
+    using T = std::common_type_t<std::ranges::range_value_t<C1>,
+                                 std::ranges::range_value_t<C2>>;
+    detail::approx_params<T> params(tol);
+    auto it1 = std::ranges::begin(c1);
+    auto it2 = std::ranges::begin(c2);
+    for (; it1 != std::ranges::end(c1) && it2 != std::ranges::end(c2);
+         ++it1, ++it2) {
+      if (!detail::approx_match<T>(*it1, *it2, params)) {
+        return false;
+      }
+    }
+    return it1 == std::ranges::end(c1) && it2 == std::ranges::end(c2);
+  }
+}
+
+template <std::floating_point T>
+bool approx_equals(T a, T b, const tolerance &tol = {}) {
+  return detail::approx_match(a, b, detail::approx_params<T>(tol));
+}
+
+// keep a value (and everything it points to) alive as far as the optimizer
+// is concerned, so benchmarked calls can not be removed as dead code
+template <typename T> inline void do_not_optimize(const T &value) {
+#if defined(__GNUC__)
+  asm volatile("" : : "r,m"(value) : "memory");
+#else
+  static volatile const void *sink;
+  sink = &value;
+  std::atomic_signal_fence(std::memory_order_seq_cst);
+#endif
+}
+
+// force pending memory writes to be treated as observable
+inline void clobber_memory() {
+#if defined(__GNUC__)
+  asm volatile("" : : : "memory");
+#else
+  std::atomic_signal_fence(std::memory_order_seq_cst);
+#endif
+}
+
+struct benchmark_options {
+  std::size_t warmup_runs = 3;
+  // each sample times a batch of calls that runs at least this long, the
+  // batch size is calibrated once before measuring
+  std::chrono::nanoseconds min_sample_time = std::chrono::milliseconds(2);
+  std::size_t samples = 30;
+  // work done by one call, used to report throughput (0 = not reported)
+  std::size_t bytes_per_call = 0;
+  std::size_t items_per_call = 0;
+};
+
+namespace detail {
+inline void append_json_string(std::string &out, std::string_view s) {
+  out.push_back('"');
+  for (char c : s) {
+    if (c == '"' || c == '\\') {
+      out.push_back('\\');
+      out.push_back(c);
+    } else if (static_cast<unsigned char>(c) < 0x20) {
+      char escaped[8];
+      std::snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+      out += escaped;
+    } else {
+      out.push_back(c);
+    }
+  }
+  out.push_back('"');
+}
+} // namespace detail
+
+// all times are nanoseconds per call
+struct benchmark_result {
+  std::string name;
+  std::size_t samples = 0;
+  std::size_t iterations_per_sample = 0;
+  double min_ns = 0;
+  double median_ns = 0;
+  double mean_ns = 0;
+  double p90_ns = 0;
+  double p99_ns = 0;
+  double max_ns = 0;
+  double stddev_ns = 0;
+  double bytes_per_second = 0;
+  double items_per_second = 0;
+
+  std::string to_string() const {
+    char line[256];
+    std::snprintf(line, sizeof(line),
+                  ": median %.2f ns, min %.2f ns, p90 %.2f ns, p99 %.2f ns, "
+                  "stddev %.2f ns",
+                  median_ns, min_ns, p90_ns, p99_ns, stddev_ns);
+    std::string out = name + line;
+    if (bytes_per_second > 0) {
+      std::snprintf(line, sizeof(line), ", %.3f GB/s", bytes_per_second / 1e9);
+      out += line;
+    }
+    if (items_per_second > 0) {
+      std::snprintf(line, sizeof(line), ", %.3f M items/s",
+                    items_per_second / 1e6);
+      out += line;
+    }
+    return out;
+  }
+
+  std::string to_json() const {
+    std::string out = "{\"name\": ";
+    detail::append_json_string(out, name);
+    auto field = [&out](std::string_view key, auto val) {
+      out += ", \"";
+      out += key;
+      out += "\": ";
+      print_to(out, val);
+    };
+    field("samples", samples);
+    field("iterations_per_sample", iterations_per_sample);
+    field("min_ns", min_ns);
+    field("median_ns", median_ns);
+    field("mean_ns", mean_ns);
+    field("p90_ns", p90_ns);
+    field("p99_ns", p99_ns);
+    field("max_ns", max_ns);
+    field("stddev_ns", stddev_ns);
+    field("bytes_per_second", bytes_per_second);
+    field("items_per_second", items_per_second);
+    out.push_back('}');
+    return out;
+  }
+};
+
+// a JSON array of results, one object per line
+inline std::string to_json(const std::vector<benchmark_result> &results) {
+  std::string out = "[";
+  for (std::size_t i = 0; i < results.size(); ++i) {
+    out += i == 0 ? "\n  " : ",\n  ";
+    out += results[i].to_json();
+  }
+  out += "\n]\n";
+  return out;
+}
+
+// totals of one probe over all threads, see UTILS_INSTRUMENT
+struct probe_stats {
+  std::string name;
+  std::uint64_t calls = 0;
+  std::uint64_t elements = 0;
+  std::uint64_t bytes = 0;
+  std::uint64_t total_ns = 0;
+  latency_histogram latency;
+
+  std::string to_json() const {
+    std::string out = "{\"name\": ";
+    detail::append_json_string(out, name);
+    auto field = [&out](std::string_view key, auto val) {
+      out += ", \"";
+      out += key;
+      out += "\": ";
+      print_to(out, val);
+    };
+    field("calls", calls);
+    field("elements", elements);
+    field("bytes", bytes);
+    field("total_ns", total_ns);
+    field("mean_ns", calls > 0 ? double(total_ns) / double(calls) : 0.0);
+    field("min_ns", latency.min());
+    field("p50_ns", latency.percentile(0.5));
+    field("p90_ns", latency.percentile(0.9));
+    field("p99_ns", latency.percentile(0.99));
+    field("max_ns", latency.max());
+    out.push_back('}');
+    return out;
+  }
+};
+
+// every probe called at least once since the last probe_reset(), summed over
+// all threads. empty when UTILS_INSTRUMENT is 0
+inline std::vector<probe_stats> probe_snapshot() {
+  std::vector<probe_stats> result;
+#if UTILS_INSTRUMENT
+  auto &registry = detail::probe_registry::instance();
+  result.resize(probe_count);
+  std::lock_guard<std::mutex> lock(registry.mutex);
+  for (const auto &slot : registry.slots) {
+    for (std::size_t id = 0; id < probe_count; ++id) {
+      const auto &c = slot->counters[id];
+      auto &stats = result[id];
+      auto load = [](const std::atomic<std::uint64_t> &x) {
+        return x.load(std::memory_order_relaxed);
+      };
+      std::uint64_t calls = load(c.calls);
+      if (calls == 0) {
+        continue;
+      }
+      auto &h = stats.latency;
+      std::uint64_t min_ns = load(c.min_ns);
+      h._min = h._total == 0 ? min_ns : std::min(h._min, min_ns);
+      h._max = std::max(h._max, load(c.max_ns));
+      for (std::size_t b = 0; b < latency_histogram::buckets; ++b) {
+        std::uint64_t n = load(c.latency[b]);
+        h._counts[b] += n;
+        h._total += n;
+      }
+      stats.calls += calls;
+      stats.elements += load(c.elements);
+      stats.bytes += load(c.bytes);
+      stats.total_ns += load(c.total_ns);
+    }
+  }
+  for (std::size_t id = 0; id < probe_count; ++id) {
+    result[id].name = probe_names[id];
+  }
+  std::erase_if(result, [](const probe_stats &s) { return s.calls == 0; });
+#endif
+  return result;
+}
+
+// zero every counter and drop the trace. updates racing with the reset may
+// be lost, call it while the probed code is idle for exact numbers
+inline void probe_reset() {
+#if UTILS_INSTRUMENT
+  auto &registry = detail::probe_registry::instance();
+  std::lock_guard<std::mutex> lock(registry.mutex);
+  for (auto &slot : registry.slots) {
+    for (auto &c : slot->counters) {
+      for (auto *x :
+           {&c.calls, &c.elements, &c.bytes, &c.total_ns, &c.max_ns}) {
+        x->store(0, std::memory_order_relaxed);
+      }
+      c.min_ns.store(std::numeric_limits<std::uint64_t>::max(),
+                     std::memory_order_relaxed);
+      for (auto &x : c.latency) {
+        x.store(0, std::memory_order_relaxed);
+      }
+    }
+    slot->trace_size.store(0, std::memory_order_relaxed);
+  }
+#endif
+}
+
+// record every probed call as a trace event (at most the first 65536 per
+// thread), off by default
+inline void probe_tracing(bool on) {
+#if UTILS_INSTRUMENT
+  detail::probe_registry::instance().tracing.store(on,
+                                                   std::memory_order_relaxed);
+#else
+  (void)on;
+#endif
+}
+
+// the recorded trace in chrome trace event format, open it in
+// chrome://tracing or https://ui.perfetto.dev
+inline std::string probe_trace_json() {
+  std::string out = "{\"displayTimeUnit\": \"ns\", \"traceEvents\": [";
+#if UTILS_INSTRUMENT
+  auto &registry = detail::probe_registry::instance();
+  std::lock_guard<std::mutex> lock(registry.mutex);
+  bool first = true;
+  char line[256];
+  for (const auto &slot : registry.slots) {
+    std::size_t n = slot->trace_size.load(std::memory_order_acquire);
+    for (std::size_t i = 0; i < n; ++i) {
+      const auto &e = slot->trace[i];
+      // timestamps are microseconds
+      std::snprintf(line, sizeof(line),
+                    "%s\n  {\"name\": \"%s\", \"cat\": \"utils\", \"ph\": "
+                    "\"X\", \"ts\": %.3f, \"dur\": %.3f, \"pid\": 0, \"tid\": "
+                    "%zu, \"args\": {\"elements\": %llu}}",
+                    first ? "" : ",",
+                    probe_names[static_cast<std::size_t>(e.id)].data(),
+                    double(e.start_ns) / 1e3, double(e.duration_ns) / 1e3,
+                    slot->thread_index,
+                    static_cast<unsigned long long>(e.elements));
+      out += line;
+      first = false;
+    }
+  }
+#endif
+  out += "\n]}\n";
+  return out;
+}
+
+// a JSON array of probe totals, one object per line
+inline std::string to_json(const std::vector<probe_stats> &stats) {
+  std::string out = "[";
+  for (std::size_t i = 0; i < stats.size(); ++i) {
+    out += i == 0 ? "\n  " : ",\n  ";
+    out += stats[i].to_json();
+  }
+  out += "\n]\n";
+  return out;
+}
+
+namespace detail {
+// linear interpolation between the closest ranks of a sorted sample
+inline double percentile(const std::vector<double> &sorted, double p) {
+  double rank = p * static_cast<double>(sorted.size() - 1);
+  auto lo = static_cast<std::size_t>(rank);
+  std::size_t hi = std::min(lo + 1, sorted.size() - 1);
+  return sorted[lo] + (sorted[hi] - sorted[lo]) * (rank - double(lo));
+}
+
+template <typename F, typename... Args>
+UTILS_ALWAYS_INLINE void invoke_kept(F &f, Args &...args) {
+  if constexpr (std::is_void_v<std::invoke_result_t<F &, Args &...>>) {
+    std::invoke(f, args...);
+    clobber_memory();
+  } else {
+    do_not_optimize(std::invoke(f, args...));
+  }
+}
+} // namespace detail
+
+/*
+benchmark(name, options, f, args...) times f(args...): warm-up runs, then a
+calibrated number of calls per sample so that nanosecond scale functions are
+measured above the clock resolution. the return value of f is passed through
+do_not_optimize.
+*/
+template <typename F, typename... Args>
+benchmark_result benchmark(std::string name, const benchmark_options &options,
+                           F &&f, Args &&...args) {
+  using clock = std::chrono::steady_clock;
+  for (std::size_t i = 0; i < options.warmup_runs; ++i) {
+    detail::invoke_kept(f, args...);
+  }
+
+  auto time_batch = [&](std::size_t iterations) {
+    auto start = clock::now();
+    for (std::size_t i = 0; i < iterations; ++i) {
+      detail::invoke_kept(f, args...);
+    }
+    return std::chrono::duration<double, std::nano>(clock::now() - start)
+        .count();
+  };
+
+  std::size_t iterations = 1;
+  double min_sample_ns =
+      std::chrono::duration<double, std::nano>(options.min_sample_time).count();
+  while (true) {
+    double elapsed = time_batch(iterations);
+    if (elapsed >= min_sample_ns || iterations >= (std::size_t(1) << 30)) {
+      break;
+    }
+    // grow towards the target, at most 10x per step
+    double factor = elapsed > 0 ? min_sample_ns * 1.2 / elapsed : 10.0;
+    iterations = static_cast<std::size_t>(
+        double(iterations) * std::clamp(factor, 2.0, 10.0));
+  }
+
+  std::size_t samples = std::max<std::size_t>(1, options.samples);
+  std::vector<double> per_call(samples);
+  for (auto &t : per_call) {
+    t = time_batch(iterations) / double(iterations);
+  }
+  std::sort(per_call.begin(), per_call.end());
+
+  benchmark_result result;
+  result.name = std::move(name);
+  result.samples = samples;
+  result.iterations_per_sample = iterations;
+  result.min_ns = per_call.front();
+  result.max_ns = per_call.back();
+  result.median_ns = detail::percentile(per_call, 0.5);
+  result.p90_ns = detail::percentile(per_call, 0.9);
+  result.p99_ns = detail::percentile(per_call, 0.99);
+  result.mean_ns =
+      std::accumulate(per_call.begin(), per_call.end(), 0.0) / double(samples);
+  double variance = 0;
+  for (double t : per_call) {
+    variance += (t - result.mean_ns) * (t - result.mean_ns);
+  }
+  result.stddev_ns = std::sqrt(variance / double(samples));
+  if (options.bytes_per_call > 0) {
+    result.bytes_per_second =
+        double(options.bytes_per_call) / result.median_ns * 1e9;
+  }
+  if (options.items_per_call > 0) {
+    result.items_per_second =
+        double(options.items_per_call) / result.median_ns * 1e9;
+  }
+  return result;
+}
+
+// quick interactive timing with the default options, prints one summary line
+template <typename F, typename... Args>
+benchmark_result timeit(F &&f, Args &&...args) {
+  auto result = benchmark("timeit", benchmark_options{}, std::forward<F>(f),
+                          std::forward<Args>(args)...);
+  println(result.to_string());
+  return result;
+}
+
+/*
+fold(f,x1,x2,x3,x4,x5...)=f(...f(f(f(f(x1,x2),x3),x4),x5)...)
+reference to : https://reference.wolfram.com/language/ref/Fold.html
+*/
+template <typename Func, typename First, typename Second>
+constexpr auto fold(Func &&f, First &&first, Second &&second) {
+  return std::forward<Func>(f)(std::forward<First>(first),
+                               std::forward<Second>(second));
+}
+
+template <typename Func, typename First, typename Second, typename... Rest>
+constexpr auto fold(Func &&f, First &&first, Second &&second, Rest &&...rest) {
+  // f is passed on as an lvalue, forwarding it twice would be a use after
+  // move for rvalue callables
+  return fold(f, f(std::forward<First>(first), std::forward<Second>(second)),
+              std::forward<Rest>(rest)...);
+}
+
+// fold(f,{x1,x2,x3...}) = fold(f,x1,x2,x3...)
+template <typename Func, std::ranges::input_range C>
+constexpr auto fold(Func &&f, C &&container) {
+  UTILS_PROBE(fold, container);
+  auto it = std::ranges::begin(container);
+  auto last = std::ranges::end(container);
+  if (it == last) {
+    throw std::runtime_error(
+        std::string("container must contain at least one element!"));
+  }
+  std::ranges::range_value_t<C> result = *it;
+  for (++it; it != last; ++it) {
+    result = f(std::move(result), *it);
+  }
+  return result;
+}
+
+namespace detail {
+// balanced tree over the pack, unrolled at compile time
+template <std::size_t Lo, std::size_t Hi, typename Func, typename Tuple>
+constexpr auto fold_tree(Func &f, Tuple &args) {
+  if constexpr (Hi - Lo == 1) {
+    return std::get<Lo>(args);
+  } else {
+    constexpr std::size_t mid = Lo + (Hi - Lo) / 2;
+    return f(fold_tree<Lo, mid>(f, args), fold_tree<mid, Hi>(f, args));
+  }
+}
+
+/*
+fold a random access block as `ways` contiguous sub-blocks that are folded in
+lockstep. the chains are independent, so they overlap in the pipeline (and
+vectorize for simple f), and combining them in order keeps the result exact
+for associative but non-commutative f.
+*/
+template <typename It, typename Func>
+constexpr auto fold_assoc_block(It first, std::size_t n, Func &f) {
+  using T = std::iter_value_t<It>;
+  constexpr std::size_t ways = 4;
+  if (n < ways * 2) {
+    T result = first[0];
+    for (std::size_t i = 1; i < n; ++i) {
+      result = f(std::move(result), first[static_cast<std::ptrdiff_t>(i)]);
+    }
+    return result;
+  }
+  std::size_t len = n / ways;
+  auto at = [&](std::size_t i) -> decltype(auto) {
+    return first[static_cast<std::ptrdiff_t>(i)];
+  };
+  std::array<T, ways> acc{T(at(0)), T(at(len)), T(at(2 * len)),
+                          T(at(3 * len))};
+  for (std::size_t i = 1; i < len; ++i) {
+    for (std::size_t k = 0; k < ways; ++k) {
+      acc[k] = f(std::move(acc[k]), at(k * len + i));
+    }
+  }
+  // the remainder continues the last sub-block
+  for (std::size_t i = ways * len; i < n; ++i) {
+    acc[ways - 1] = f(std::move(acc[ways - 1]), at(i));
+  }
+  return T(f(f(std::move(acc[0]), std::move(acc[1])),
+             f(std::move(acc[2]), std::move(acc[3]))));
+}
+} // namespace detail
+
+/*
+fold_assoc(f,...) gives the same result as fold(f,...) when f is associative
+(f need not be commutative), but reduces as a balanced tree instead of a
+left-to-right chain.
+fold_assoc(f,x1,x2,x3...) is unrolled at compile time,
+fold_assoc(f,container) folds independent sub-blocks in lockstep and
+fold_assoc(utils::par,f,container) also reduces chunks on a thread pool.
+*/
+template <typename Func, typename First, typename Second, typename... Rest>
+requires(!ExecutionPolicy<Func>)
+constexpr auto fold_assoc(Func &&f, First &&first, Second &&second,
+                          Rest &&...rest) {
+  auto args = std::forward_as_tuple(std::forward<First>(first),
+                                    std::forward<Second>(second),
+                                    std::forward<Rest>(rest)...);
+  return detail::fold_tree<0, sizeof...(Rest) + 2>(f, args);
+}
+
+template <typename Func, std::ranges::input_range C>
+constexpr auto fold_assoc(Func &&f, C &&container) {
+  UTILS_PROBE(fold_assoc, container);
+  if constexpr (std::ranges::random_access_range<C> &&
+                std::ranges::sized_range<C>) {
+    if (std::ranges::empty(container)) {
+      throw std::runtime_error(
+          std::string("container must contain at least one element!"));
+    }
+    return detail::fold_assoc_block(std::ranges::begin(container),
+                                    std::ranges::size(container), f);
+  } else {
+    return fold(std::forward<Func>(f), std::forward<C>(container));
+  }
+}
+
+template <ExecutionPolicy P, typename Func, detail::ParallelInput C>
+auto fold_assoc(P &&policy, Func &&f, C &&container) {
+  UTILS_PROBE(fold_assoc, container);
+  if (std::ranges::empty(container)) {
+    throw std::runtime_error(
+        std::string("container must contain at least one element!"));
+  }
+  return detail::parallel_reduce(
+      detail::pool_of(policy), container,
+      [&f](auto chunk) {
+        return detail::fold_assoc_block(chunk.begin(), chunk.size(), f);
+      },
+      [&f](auto &&a, auto &&b) {
+        return std::ranges::range_value_t<C>(f(std::forward<decltype(a)>(a),
+                                               std::forward<decltype(b)>(b)));
+      });
+}
+
+namespace detail {
+// __builtin_shuffle(x, zero, mask) moves the lanes of x up by Shift
+template <typename IVec, std::size_t Lanes, std::size_t Shift, typename Seq>
+struct shift_up_mask;
+template <typename IVec, std::size_t Lanes, std::size_t Shift,
+          std::size_t... J>
+struct shift_up_mask<IVec, Lanes, Shift, std::index_sequence<J...>> {
+  using lane = std::remove_cvref_t<decltype(IVec{}[0])>;
+  static constexpr IVec value{
+      static_cast<lane>(J < Shift ? Lanes + J : J - Shift)...};
+};
+
+// x += x with its lanes moved up by Shift (zeros shifted in at the bottom)
+template <typename Vec, typename IVec, std::size_t Lanes, std::size_t Shift>
+UTILS_ALWAYS_INLINE void add_shifted_lanes(Vec &x) {
+  if constexpr (Shift < Lanes) {
+    x += __builtin_shuffle(
+        x, Vec{},
+        shift_up_mask<IVec, Lanes, Shift,
+                      std::make_index_sequence<Lanes>>::value);
+  }
+}
+
+/*
+inclusive prefix sum of in[0..n) added to carry, written to out (which may
+be in), returns the running total. every vector is scanned in log2(lanes)
+shift-and-add steps that do not depend on the previous vector, the only
+loop-carried dependency is adding the broadcast vector total to the carry.
+*/
+template <typename T, std::size_t Bytes>
+UTILS_ALWAYS_INLINE T scan_kernel(const T *in, T *out, std::size_t n,
+                                  T carry) {
+  std::size_t i = 0;
+#if defined(__GNUC__)
+  typedef T vec __attribute__((vector_size(Bytes)));
+  typedef lane_int_t<T> ivec __attribute__((vector_size(Bytes)));
+  constexpr std::size_t lanes = Bytes / sizeof(T);
+  constexpr ivec last = ivec{} + static_cast<lane_int_t<T>>(lanes - 1);
+  vec carry_v = vec{} + carry;
+  for (; i + lanes <= n; i += lanes) {
+    vec x;
+    std::memcpy(&x, in + i, Bytes);
+    add_shifted_lanes<vec, ivec, lanes, 1>(x);
+    add_shifted_lanes<vec, ivec, lanes, 2>(x);
+    add_shifted_lanes<vec, ivec, lanes, 4>(x);
+    add_shifted_lanes<vec, ivec, lanes, 8>(x);
+    vec y = x + carry_v;
+    std::memcpy(out + i, &y, Bytes);
+    carry_v += __builtin_shuffle(x, last);
+  }
+  carry = carry_v[0];
+#endif
+  for (; i < n; ++i) {
+    carry += in[i];
+    out[i] = carry;
+  }
+  return carry;
+}
+
+#if UTILS_X86_DISPATCH
+template <typename T>
+__attribute__((target("avx2"))) T scan_avx2(const T *in, T *out,
+                                            std::size_t n, T carry) {
+  return scan_kernel<T, 32>(in, out, n, carry);
+}
+
+template <typename T>
+__attribute__((target("avx512f"))) T scan_avx512(const T *in, T *out,
+                                                std::size_t n, T carry) {
+  return scan_kernel<T, 64>(in, out, n, carry);
+}
+#endif
+
+template <typename T>
+T scan_contiguous(const T *in, T *out, std::size_t n, T carry) {
+  if constexpr (sizeof(T) < 4) {
+    // byte and short lanes need too many shuffles to pay off
+    for (std::size_t i = 0; i < n; ++i) {
+      carry += in[i];
+      out[i] = carry;
+    }
+    return carry;
+  } else {
+#if UTILS_X86_DISPATCH
+    switch (detect_simd_level()) {
+    case simd_level::avx512:
+      return scan_avx512(in, out, n, carry);
+    case simd_level::avx2:
+      return scan_avx2(in, out, n, carry);
+    default:
+      break;
+    }
+#endif
+    return scan_kernel<T, 16>(in, out, n, carry);
+  }
+}
+
+template <typename F, typename T>
+concept PlusOf = std::same_as<std::decay_t<F>, std::plus<>> ||
+    std::same_as<std::decay_t<F>, std::plus<T>>;
+
+/*
+out[i] = f(...f(f(carry, in[0]), in[1])..., in[i]) for i < n, without a
+carry out[0] = in[0]. std::plus over pointers to SIMD types goes through
+scan_contiguous.
+*/
+template <typename T, typename Func, typename It, typename Out>
+constexpr void scan_block(Func &f, It first, std::size_t n, Out out,
+                          const std::optional<T> &carry) {
+  if (n == 0) {
+    return;
+  }
+  if constexpr (PlusOf<Func, T> && SimdArithmetic<T> &&
+                std::is_pointer_v<It> &&
+                std::is_same_v<std::remove_cv_t<std::remove_pointer_t<It>>,
+                               T> &&
+                std::is_same_v<Out, T *>) {
+    if (!std::is_constant_evaluated()) {
+      if (carry) {
+        scan_contiguous<T>(first, out, n, *carry);
+      } else {
+        out[0] = first[0];
+        scan_contiguous<T>(first + 1, out + 1, n - 1, first[0]);
+      }
+      return;
+    }
+  }
+  T acc = carry ? T(f(*carry, *first)) : T(*first);
+  *out = acc;
+  for (std::size_t i = 1; i < n; ++i) {
+    ++first;
+    ++out;
+    acc = f(std::move(acc), *first);
+    *out = acc;
+  }
+}
+
+template <typename R> constexpr auto scan_begin(R &&r) {
+  if constexpr (std::ranges::contiguous_range<R>) {
+    return std::ranges::data(r);
+  } else {
+    return std::ranges::begin(r);
+  }
+}
+
+template <typename C, typename Out>
+constexpr void check_scan_output(C &c, Out &out, const char *name) {
+  static_assert(
+      std::same_as<std::ranges::range_value_t<Out>,
+                   std::ranges::range_value_t<C>>,
+      "fold_list_into: output element type must match the input element type");
+  if (std::ranges::size(out) < std::ranges::size(c)) {
+    throw std::runtime_error(std::string(name) +
+                             ": output buffer smaller than the input");
+  }
+}
+} // namespace detail
+
+/*
+fold_list(f,{x1,x2,x3...}) = {x1, f(x1,x2), f(f(x1,x2),x3), ...}
+fold_list(f,x,{x1,x2,x3...}) = {x, f(x,x1), f(f(x,x1),x2), ...}
+reference to : https://reference.wolfram.com/language/ref/FoldList.html
+the last element is fold(f,...). fold_list(std::plus<>{},0,sizes) turns sizes
+into offsets with the total at the end. for std::plus over contiguous
+arithmetic data a SIMD scan kernel is used, floating point results may then
+differ in the last bits from a left to right loop (like sum).
+fold_list_into(f,c,out) writes into a caller provided buffer, out may be c.
+*/
+template <typename Func, std::ranges::random_access_range C,
+          std::ranges::random_access_range Out>
+requires std::ranges::sized_range<C> && std::ranges::sized_range<Out>
+constexpr void fold_list_into(Func &&f, C &&c, Out &&out) {
+  UTILS_PROBE(fold_list, c);
+  detail::check_scan_output(c, out, "fold_list_into");
+  detail::scan_block<std::ranges::range_value_t<C>>(
+      f, detail::scan_begin(c), std::ranges::size(c), detail::scan_begin(out),
+      std::nullopt);
+}
+
+template <typename Func, std::ranges::input_range C, ResultAllocator A>
+constexpr auto fold_list(Func &&f, C &&c, const A &alloc) {
+  UTILS_PROBE(fold_list, c);
+  using T = std::ranges::range_value_t<C>;
+  detail::result_vector_t<T, A> result(detail::rebind_alloc<T>(alloc));
+  if constexpr (std::ranges::random_access_range<C> &&
+                std::ranges::sized_range<C> &&
+                std::default_initializable<T>) {
+    result.resize(std::ranges::size(c));
+    fold_list_into(f, c, result);
+  } else {
+    for (auto &&x : c) {
+      result.push_back(result.empty() ? T(x) : T(f(result.back(), x)));
+    }
+  }
+  return result;
+}
+
+template <typename Func, std::ranges::input_range C>
+requires(!ExecutionPolicy<Func>)
+constexpr auto fold_list(Func &&f, C &&c) {
+  return fold_list(std::forward<Func>(f), std::forward<C>(c),
+                   std::allocator<std::ranges::range_value_t<C>>());
+}
+
+template <typename Func, typename Start, std::ranges::input_range C,
+          ResultAllocator A>
+requires(!ExecutionPolicy<Func>)
+constexpr auto fold_list(Func &&f, Start &&start, C &&c, const A &alloc) {
+  UTILS_PROBE(fold_list, c);
+  using T = std::decay_t<Start>;
+  detail::result_vector_t<T, A> result(detail::rebind_alloc<T>(alloc));
+  if constexpr (std::ranges::sized_range<C>) {
+    result.reserve(std::ranges::size(c) + 1);
+  }
+  result.emplace_back(std::forward<Start>(start));
+  for (auto &&x : c) {
+    result.push_back(f(result.back(), x));
+  }
+  return result;
+}
+
+template <typename Func, typename Start, std::ranges::input_range C>
+requires(!ExecutionPolicy<Func> && !ResultAllocator<C>)
+constexpr auto fold_list(Func &&f, Start &&start, C &&c) {
+  return fold_list(std::forward<Func>(f), std::forward<Start>(start),
+                   std::forward<C>(c), std::allocator<std::decay_t<Start>>());
+}
+
+/*
+fold_list(utils::par,f,c) and fold_list_into(utils::par,f,c,out) need an
+associative f. they scan in two passes over fixed size chunks: every chunk
+is reduced in parallel, the chunk totals are scanned into offsets, then every
+chunk is scanned from its offset in parallel.
+*/
+template <ExecutionPolicy P, typename Func, detail::ParallelInput C,
+          std::ranges::random_access_range Out>
+requires std::ranges::sized_range<Out>
+void fold_list_into(P &&policy, Func &&f, C &&c, Out &&out) {
+  UTILS_PROBE(fold_list, c);
+  using T = std::ranges::range_value_t<C>;
+  detail::check_scan_output(c, out, "fold_list_into");
+  std::size_t n = std::ranges::size(c);
+  std::size_t chunk = detail::cache_chunk<T>;
+  if (n <= chunk) {
+    fold_list_into(f, c, out);
+    return;
+  }
+  std::size_t chunks = (n + chunk - 1) / chunk;
+  auto &pool = detail::pool_of(policy);
+  auto in = detail::scan_begin(c);
+  auto dst = detail::scan_begin(out);
+  auto length = [&](std::size_t i) { return std::min(chunk, n - i * chunk); };
+  auto at = [](auto it, std::size_t i) {
+    return it + static_cast<std::ptrdiff_t>(i);
+  };
+  // the last chunk's total is not needed
+  std::vector<std::optional<T>> offsets(chunks);
+  pool.parallel_for(chunks - 1, [&](std::size_t i) {
+    if constexpr (detail::PlusOf<Func, T> &&
+                  detail::ContiguousSimdRange<C>) {
+      offsets[i + 1].emplace(detail::reduce_contiguous<detail::reduce_op::sum>(
+          at(in, i * chunk), length(i)));
+    } else {
+      offsets[i + 1].emplace(
+          detail::fold_assoc_block(at(in, i * chunk), length(i), f));
+    }
+  });
+  for (std::size_t i = 2; i < chunks; ++i) {
+    offsets[i].emplace(f(*offsets[i - 1], std::move(*offsets[i])));
+  }
+  pool.parallel_for(chunks, [&](std::size_t i) {
+    detail::scan_block<T>(f, at(in, i * chunk), length(i), at(dst, i * chunk),
+                          offsets[i]);
+  });
+}
+
+template <ExecutionPolicy P, typename Func, detail::ParallelInput C>
+auto fold_list(P &&policy, Func &&f, C &&c) {
+  using T = std::ranges::range_value_t<C>;
+  std::vector<T> result(std::ranges::size(c));
+  fold_list_into(policy, f, c, result);
+  return result;
+}
+
+/*
+accumulate_list({x1,x2,x3...}) = {x1, x1+x2, x1+x2+x3, ...}
+reference to : https://reference.wolfram.com/language/ref/Accumulate.html
+the same as fold_list(std::plus<>{},...), see there for the variants
+*/
+template <ContainerWithArithmeticElement C, ResultAllocator A>
+constexpr auto accumulate_list(C &&c, const A &alloc) {
+  UTILS_PROBE(accumulate_list, c);
+  return fold_list(std::plus<>{}, std::forward<C>(c), alloc);
+}
+
+template <ContainerWithArithmeticElement C>
+constexpr auto accumulate_list(C &&c) {
+  UTILS_PROBE(accumulate_list, c);
+  return fold_list(std::plus<>{}, std::forward<C>(c));
+}
+
+template <ExecutionPolicy P, ContainerWithArithmeticElement C>
+requires detail::ParallelInput<C>
+auto accumulate_list(P &&policy, C &&c) {
+  UTILS_PROBE(accumulate_list, c);
+  return fold_list(policy, std::plus<>{}, std::forward<C>(c));
+}
+
+template <ContainerWithArithmeticElement C, typename Out>
+constexpr void accumulate_list_into(C &&c, Out &&out) {
+  UTILS_PROBE(accumulate_list, c);
+  fold_list_into(std::plus<>{}, c, out);
+}
+
+template <ExecutionPolicy P, ContainerWithArithmeticElement C, typename Out>
+void accumulate_list_into(P &&policy, C &&c, Out &&out) {
+  UTILS_PROBE(accumulate_list, c);
+  fold_list_into(policy, std::plus<>{}, c, out);
+}
+
+namespace detail {
+// dot/inner/outer operands: vectors are containers of arithmetic values or
+// rank 1 tensors, matrices are nested containers or rank 2 tensors
+template <typename C> constexpr std::size_t array_depth() {
+  if constexpr (Tensor<C>) {
+    return std::remove_cvref_t<C>::rank();
+  } else {
+    return nesting_depth<std::remove_cvref_t<C>>();
+  }
+}
+
+template <typename C> struct array_element {
+  using type = typename innermost_value<std::remove_cvref_t<C>>::type;
+};
+template <Tensor C> struct array_element<C> {
+  using type = typename std::remove_cvref_t<C>::value_type;
+};
+template <typename C> using array_element_t = typename array_element<C>::type;
+
+template <typename C>
+concept ArrayOperand = (array_depth<C>() == 1 || array_depth<C>() == 2) &&
+    Arithmetic<array_element_t<C>>;
+
+template <typename C>
+concept VectorOperand = ArrayOperand<C> && array_depth<C>() == 1;
+
+// a vector operand as pointer and stride, copied only if its elements are
+// not T or not addressable that way
+template <typename T> struct vector_operand {
+  std::vector<T> storage;
+  const T *data = nullptr;
+  std::size_t size = 0;
+  std::ptrdiff_t stride = 1;
+
+  const T &operator[](std::size_t i) const {
+    return data[static_cast<std::ptrdiff_t>(i) * stride];
+  }
+};
+
+template <typename T, typename C> vector_operand<T> as_vector(const C &c) {
+  vector_operand<T> v;
+  if constexpr (Tensor<C> && std::same_as<array_element_t<C>, T>) {
+    tensor_view<const T, 1> view(c);
+    v.data = view.data();
+    v.size = view.extent(0);
+    v.stride = view.strides()[0];
+  } else if constexpr (std::ranges::contiguous_range<const C &> &&
+                       std::ranges::sized_range<const C &> &&
+                       std::same_as<std::ranges::range_value_t<C>, T>) {
+    v.data = std::ranges::data(c);
+    v.size = std::ranges::size(c);
+  } else {
+    for (const auto &x : c) {
+      v.storage.push_back(static_cast<T>(x));
+    }
+    v.data = v.storage.data();
+    v.size = v.storage.size();
+  }
+  return v;
+}
+
+// element (i, j) of a strided matrix is data[i * row_stride + j * col_stride]
+template <typename T> struct matrix_ref {
+  const T *data = nullptr;
+  std::size_t rows = 0;
+  std::size_t cols = 0;
+  std::ptrdiff_t row_stride = 0;
+  std::ptrdiff_t col_stride = 1;
+
+  const T &operator()(std::size_t i, std::size_t j) const {
+    return data[static_cast<std::ptrdiff_t>(i) * row_stride +
+                static_cast<std::ptrdiff_t>(j) * col_stride];
+  }
+  vector_operand<T> row(std::size_t i) const {
+    return {{}, data + static_cast<std::ptrdiff_t>(i) * row_stride, cols,
+            col_stride};
+  }
+  matrix_ref row_block(std::size_t first, std::size_t count) const {
+    matrix_ref block = *this;
+    block.data += static_cast<std::ptrdiff_t>(first) * row_stride;
+    block.rows = count;
+    return block;
+  }
+};
+
+// a tensor operand is viewed in place, a nested container is copied into a
+// dense tensor (throws if it is ragged)
+template <typename T> struct matrix_operand {
+  tensor<T, 2> storage;
+  matrix_ref<T> ref;
+};
+
+template <typename T, typename C> matrix_operand<T> as_matrix(const C &c) {
+  matrix_operand<T> m;
+  if constexpr (Tensor<C> && std::same_as<array_element_t<C>, T>) {
+    tensor_view<const T, 2> view(c);
+    m.ref = {view.data(), view.extent(0), view.extent(1), view.strides()[0],
+             view.strides()[1]};
+    return m;
+  } else {
+    if constexpr (Tensor<C>) {
+      m.storage = tensor<T, 2>(
+          tensor_view<const array_element_t<C>, 2>(c));
+    } else {
+      std::array<std::size_t, 2> shape{};
+      nested_shape<0>(c, shape);
+      m.storage = tensor<T, 2>(shape);
+      T *out = m.storage.data();
+      nested_copy<0>(c, shape, out);
+    }
+    m.ref = {m.storage.data(), m.storage.extent(0), m.storage.extent(1),
+             static_cast<std::ptrdiff_t>(m.storage.extent(1)), 1};
+    return m;
+  }
+}
+
+// rows x cols of a matrix operand, a nested container is measured by its
+// first row
+template <typename C> std::array<std::size_t, 2> operand_shape(const C &c) {
+  if constexpr (Tensor<C>) {
+    return {c.extent(0), c.extent(1)};
+  } else {
+    std::array<std::size_t, 2> shape{};
+    nested_shape<0>(c, shape);
+    return shape;
+  }
+}
+
+// row i of a matrix operand without copying it, for tensors and random
+// access nested containers
+template <typename C>
+concept IndexableRows =
+    Tensor<C> || std::ranges::random_access_range<const C &>;
+
+template <typename T, IndexableRows C>
+vector_operand<T> operand_row(const C &c, std::size_t i) {
+  if constexpr (Tensor<C>) {
+    return as_vector<T>(tensor_view<const array_element_t<C>, 2>(c)[i]);
+  } else {
+    return as_vector<T>(std::ranges::begin(c)[static_cast<std::ptrdiff_t>(i)]);
+  }
+}
+
+// calls fn(i, row) for every row of a matrix operand, checking that all rows
+// have cols entries
+template <typename T, typename C, typename F>
+void for_each_row(const C &c, std::size_t cols, F &&fn) {
+  auto visit = [&](std::size_t i, vector_operand<T> row) {
+    if (row.size != cols) {
+      throw std::runtime_error("dot: nested container is ragged");
+    }
+    fn(i, row);
+  };
+  if constexpr (IndexableRows<C>) {
+    std::size_t rows = operand_shape(c)[0];
+    for (std::size_t i = 0; i < rows; ++i) {
+      visit(i, operand_row<T>(c, i));
+    }
+  } else {
+    std::size_t i = 0;
+    for (const auto &row : c) {
+      visit(i++, as_vector<T>(row));
+    }
+  }
+}
+
+inline void check_conform(std::size_t inner_a, std::size_t inner_b,
+                          const char *name) {
+  if (inner_a != inner_b) {
+    throw std::runtime_error(std::string(name) + ": incompatible shapes");
+  }
+}
+
+// the result of dot/inner is a tensor if either operand is one, a (nested)
+// std::vector otherwise
+template <typename A, typename B, typename R, std::size_t Rank>
+auto array_result(tensor<R, Rank> &&result) {
+  if constexpr (Tensor<A> || Tensor<B>) {
+    return std::move(result);
+  } else {
+    return result.to_nested();
+  }
+}
+
+/*
+acc += x * y on a scalar or on every lane of a vector. Fused is set by the
+kernels compiled for a target with FMA (the avx2,fma and avx512f wrappers):
+floating point lanes then use std::fma, which those targets turn into one
+vfmadd per vector, instead of relying on the compiler to contract. without
+FMA hardware std::fma is a library call, so the baseline kernels multiply and
+add separately.
+*/
+template <typename T, bool Fused, typename V>
+UTILS_ALWAYS_INLINE void multiply_add(V &acc, const V &x, const V &y) {
+  if constexpr (Fused && std::is_floating_point_v<T>) {
+    if constexpr (std::is_same_v<V, T>) {
+      acc = std::fma(x, y, acc);
+    } else {
+      constexpr std::size_t lanes = sizeof(V) / sizeof(T);
+      for (std::size_t j = 0; j < lanes; ++j) {
+        acc[j] = std::fma(x[j], y[j], acc[j]);
+      }
+    }
+  } else {
+    acc += x * y;
+  }
+}
+
+template <typename T, std::size_t Bytes, bool Fused>
+UTILS_ALWAYS_INLINE T dot_kernel(const T *a, const T *b, std::size_t n) {
+  constexpr std::size_t unroll = 4;
+  std::size_t i = 0;
+  T result = T(0);
+#if defined(__GNUC__)
+  typedef T vec __attribute__((vector_size(Bytes)));
+  constexpr std::size_t lanes = Bytes / sizeof(T);
+  vec acc[unroll] = {};
+  for (; i + unroll * lanes <= n; i += unroll * lanes) {
+    for (std::size_t u = 0; u < unroll; ++u) {
+      vec x;
+      vec y;
+      std::memcpy(&x, a + i + u * lanes, Bytes);
+      std::memcpy(&y, b + i + u * lanes, Bytes);
+      multiply_add<T, Fused>(acc[u], x, y);
+    }
+  }
+  for (std::size_t u = 1; u < unroll; ++u) {
+    acc[0] += acc[u];
+  }
+  for (std::size_t j = 0; j < lanes; ++j) {
+    result += acc[0][j];
+  }
+#endif
+  for (; i < n; ++i) {
+    multiply_add<T, Fused>(result, a[i], b[i]);
+  }
+  return result;
+}
+
+// y[0..n) += alpha * x[0..n)
+template <typename T, std::size_t Bytes, bool Fused>
+UTILS_ALWAYS_INLINE void axpy_kernel(T alpha, const T *x, T *y,
+                                     std::size_t n) {
+  std::size_t i = 0;
+#if defined(__GNUC__)
+  typedef T vec __attribute__((vector_size(Bytes)));
+  constexpr std::size_t lanes = Bytes / sizeof(T);
+  vec a = vec{} + alpha;
+  for (; i + 2 * lanes <= n; i += 2 * lanes) {
+    vec x0;
+    vec x1;
+    vec y0;
+    vec y1;
+    std::memcpy(&x0, x + i, Bytes);
+    std::memcpy(&x1, x + i + lanes, Bytes);
+    std::memcpy(&y0, y + i, Bytes);
+    std::memcpy(&y1, y + i + lanes, Bytes);
+    multiply_add<T, Fused>(y0, a, x0);
+    multiply_add<T, Fused>(y1, a, x1);
+    std::memcpy(y + i, &y0, Bytes);
+    std::memcpy(y + i + lanes, &y1, Bytes);
   }
-  if (c.size() < N) {
-    throw std::runtime_error("vunpack: container size less than N");
+#endif
+  for (; i < n; ++i) {
+    multiply_add<T, Fused>(y[i], alpha, x[i]);
   }
-  return [&c]<std::size_t... Is>(std::index_sequence<Is...>) {
-    return std::make_tuple(c[Is]...);
+}
+
+/*
+matrix product in the style of BLIS/GotoBLAS. B is packed into kc x nc
+panels (L3) of nr wide column strips, A into mc x kc blocks (L2) of mr high
+row strips, so the micro-kernel reads both from contiguous, cache resident
+memory whatever the strides of the operands. the micro-kernel keeps an
+mr x nr tile of C in registers (mr x 2 vectors) and does a rank-1 update per
+step of k: two vector loads of B, mr broadcasts of A. partial strips are
+packed with zeros, only the write back of edge tiles is masked.
+*/
+template <typename T, std::size_t Bytes> struct gemm_blocking {
+  static constexpr std::size_t lanes = Bytes / sizeof(T);
+  // accumulators + 2 B vectors + 1 broadcast fit the 16 (32 with AVX-512)
+  // vector registers
+  static constexpr std::size_t mr = Bytes == 64 ? 12 : 6;
+  static constexpr std::size_t nr = 2 * lanes;
+  static constexpr std::size_t kc = 256;
+  static constexpr std::size_t mc = 96;
+  static constexpr std::size_t nc = 2048;
+};
+
+template <std::size_t MR, typename T>
+void gemm_pack_a(const matrix_ref<T> &a, std::size_t i0, std::size_t p0,
+                 std::size_t mc, std::size_t kc, T *out) {
+  for (std::size_t ir = 0; ir < mc; ir += MR) {
+    std::size_t rows = std::min(MR, mc - ir);
+    for (std::size_t p = 0; p < kc; ++p) {
+      for (std::size_t r = 0; r < rows; ++r) {
+        out[r] = a(i0 + ir + r, p0 + p);
+      }
+      for (std::size_t r = rows; r < MR; ++r) {
+        out[r] = T(0);
+      }
+      out += MR;
+    }
   }
-  (std::make_index_sequence<N>{});
 }
 
-template <std::size_t N>
-auto vunpack(NestedContainerWithArithmeticElement auto &&c) {
-  if constexpr (N <= 0) {
-    throw std::runtime_error("vunpack: N must be greater than 0");
+template <std::size_t NR, typename T>
+void gemm_pack_b(const matrix_ref<T> &b, std::size_t p0, std::size_t j0,
+                 std::size_t kc, std::size_t nc, T *out) {
+  for (std::size_t jr = 0; jr < nc; jr += NR) {
+    std::size_t cols = std::min(NR, nc - jr);
+    for (std::size_t p = 0; p < kc; ++p) {
+      const T *row = &b(p0 + p, j0 + jr);
+      if (b.col_stride == 1 && cols == NR) {
+        std::memcpy(out, row, NR * sizeof(T));
+      } else {
+        for (std::size_t c = 0; c < cols; ++c) {
+          out[c] = row[static_cast<std::ptrdiff_t>(c) * b.col_stride];
+        }
+        for (std::size_t c = cols; c < NR; ++c) {
+          out[c] = T(0);
+        }
+      }
+      out += NR;
+    }
   }
-  if (c.size() < N) {
-    throw std::runtime_error("vunpack: container size less than N");
+}
+
+// c (rows ldc apart) = a_strip * b_strip, or += if accumulate
+#if defined(__GNUC__)
+template <typename T, std::size_t Bytes, std::size_t MR, bool Fused>
+UTILS_ALWAYS_INLINE void gemm_micro(std::size_t kc, const T *a, const T *b,
+                                    T *c, std::size_t ldc, std::size_t rows,
+                                    std::size_t cols, bool accumulate) {
+  typedef T vec __attribute__((vector_size(Bytes)));
+  constexpr std::size_t lanes = Bytes / sizeof(T);
+  vec acc[MR][2];
+#pragma GCC unroll 16
+  for (std::size_t r = 0; r < MR; ++r) {
+    acc[r][0] = vec{};
+    acc[r][1] = vec{};
   }
-  return [&c]<std::size_t... Is>(std::index_sequence<Is...>) {
-    return std::make_tuple(c[Is]...);
+  for (std::size_t p = 0; p < kc; ++p) {
+    vec b0;
+    vec b1;
+    std::memcpy(&b0, b, Bytes);
+    std::memcpy(&b1, b + lanes, Bytes);
+#pragma GCC unroll 16
+    for (std::size_t r = 0; r < MR; ++r) {
+      vec x = vec{} + a[r];
+      multiply_add<T, Fused>(acc[r][0], x, b0);
+      multiply_add<T, Fused>(acc[r][1], x, b1);
+    }
+    a += MR;
+    b += 2 * lanes;
+  }
+  if (rows == MR && cols == 2 * lanes) {
+#pragma GCC unroll 16
+    for (std::size_t r = 0; r < MR; ++r) {
+      T *row = c + r * ldc;
+      if (accumulate) {
+        vec c0;
+        vec c1;
+        std::memcpy(&c0, row, Bytes);
+        std::memcpy(&c1, row + lanes, Bytes);
+        acc[r][0] += c0;
+        acc[r][1] += c1;
+      }
+      std::memcpy(row, &acc[r][0], Bytes);
+      std::memcpy(row + lanes, &acc[r][1], Bytes);
+    }
+  } else {
+    for (std::size_t r = 0; r < rows; ++r) {
+      T tile[2 * lanes];
+      std::memcpy(tile, &acc[r][0], 2 * Bytes);
+      T *row = c + r * ldc;
+      for (std::size_t j = 0; j < cols; ++j) {
+        row[j] = accumulate ? T(row[j] + tile[j]) : tile[j];
+      }
+    }
   }
-  (std::make_index_sequence<N>{});
 }
 
-template <ContainerWithArithmeticElement C, typename Predicate>
-auto select(C &&c, Predicate &&pred) {
-  using ValueType = typename std::decay_t<decltype(*c.begin())>;
-  std::vector<ValueType> result;
-  for (const auto &val : c) {
-    if (pred(val)) {
-      result.push_back(val);
+// c (rows ldc apart) = a * b, with packing buffers sized for the operands
+template <typename T, std::size_t Bytes, bool Fused>
+UTILS_ALWAYS_INLINE void gemm_kernel(const matrix_ref<T> &a,
+                                     const matrix_ref<T> &b, T *c,
+                                     std::size_t ldc) {
+  using blocking = gemm_blocking<T, Bytes>;
+  constexpr std::size_t mr = blocking::mr;
+  constexpr std::size_t nr = blocking::nr;
+  std::size_t kc_max = std::min(blocking::kc, a.cols);
+  std::size_t mc_max = std::min(blocking::mc, (a.rows + mr - 1) / mr * mr);
+  std::size_t nc_max = std::min(blocking::nc, (b.cols + nr - 1) / nr * nr);
+  std::vector<T, aligned_allocator<T>> pack_a(mc_max * kc_max);
+  std::vector<T, aligned_allocator<T>> pack_b(kc_max * nc_max);
+  for (std::size_t j0 = 0; j0 < b.cols; j0 += blocking::nc) {
+    std::size_t nc = std::min(blocking::nc, b.cols - j0);
+    for (std::size_t p0 = 0; p0 < a.cols; p0 += blocking::kc) {
+      std::size_t kc = std::min(blocking::kc, a.cols - p0);
+      gemm_pack_b<nr>(b, p0, j0, kc, nc, pack_b.data());
+      for (std::size_t i0 = 0; i0 < a.rows; i0 += blocking::mc) {
+        std::size_t mc = std::min(blocking::mc, a.rows - i0);
+        gemm_pack_a<mr>(a, i0, p0, mc, kc, pack_a.data());
+        for (std::size_t jr = 0; jr < nc; jr += nr) {
+          for (std::size_t ir = 0; ir < mc; ir += mr) {
+            gemm_micro<T, Bytes, mr, Fused>(
+                kc, pack_a.data() + ir * kc, pack_b.data() + jr * kc,
+                c + (i0 + ir) * ldc + j0 + jr, ldc, std::min(mr, mc - ir),
+                std::min(nr, nc - jr), p0 > 0);
+          }
+        }
+      }
+    }
+  }
+}
+
+#endif
+
+#if UTILS_X86_DISPATCH
+template <typename T>
+__attribute__((target("avx2,fma"))) T dot_avx2(const T *a, const T *b,
+                                               std::size_t n) {
+  return dot_kernel<T, 32, true>(a, b, n);
+}
+
+template <typename T>
+__attribute__((target("avx512f"))) T dot_avx512(const T *a, const T *b,
+                                                std::size_t n) {
+  return dot_kernel<T, 64, true>(a, b, n);
+}
+
+template <typename T>
+__attribute__((target("avx2,fma"))) void
+axpy_avx2(T alpha, const T *x, T *y, std::size_t n) {
+  axpy_kernel<T, 32, true>(alpha, x, y, n);
+}
+
+template <typename T>
+__attribute__((target("avx512f"))) void
+axpy_avx512(T alpha, const T *x, T *y, std::size_t n) {
+  axpy_kernel<T, 64, true>(alpha, x, y, n);
+}
+
+template <typename T>
+__attribute__((target("avx2,fma"))) void
+gemm_avx2(const matrix_ref<T> &a, const matrix_ref<T> &b, T *c,
+          std::size_t ldc) {
+  gemm_kernel<T, 32, true>(a, b, c, ldc);
+}
+
+template <typename T>
+__attribute__((target("avx512f"))) void
+gemm_avx512(const matrix_ref<T> &a, const matrix_ref<T> &b, T *c,
+            std::size_t ldc) {
+  gemm_kernel<T, 64, true>(a, b, c, ldc);
+}
+
+// the avx2 kernels are built with fma, which a few early AVX2 parts lack
+inline bool has_avx2_fma() {
+  static const bool fma = [] {
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("fma") != 0;
+  }();
+  return fma;
+}
+#endif
+
+template <typename T> T dot_contiguous(const T *a, const T *b, std::size_t n) {
+#if UTILS_X86_DISPATCH
+  switch (detect_simd_level()) {
+  case simd_level::avx512:
+    return dot_avx512(a, b, n);
+  case simd_level::avx2:
+    if (has_avx2_fma()) {
+      return dot_avx2(a, b, n);
+    }
+    break;
+  default:
+    break;
+  }
+#endif
+  return dot_kernel<T, 16, false>(a, b, n);
+}
+
+template <typename T>
+void axpy_contiguous(T alpha, const T *x, T *y, std::size_t n) {
+#if UTILS_X86_DISPATCH
+  switch (detect_simd_level()) {
+  case simd_level::avx512:
+    return axpy_avx512(alpha, x, y, n);
+  case simd_level::avx2:
+    if (has_avx2_fma()) {
+      return axpy_avx2(alpha, x, y, n);
+    }
+    break;
+  default:
+    break;
+  }
+#endif
+  axpy_kernel<T, 16, false>(alpha, x, y, n);
+}
+
+// c (rows ldc apart) = a * b. tiny products are not worth packing
+template <typename T>
+void gemm(const matrix_ref<T> &a, const matrix_ref<T> &b, T *c,
+          std::size_t ldc) {
+#if defined(__GNUC__)
+  constexpr bool packed = SimdArithmetic<T>;
+#else
+  constexpr bool packed = false;
+#endif
+  if (!packed || a.rows * a.cols * b.cols <= 4096) {
+    for (std::size_t i = 0; i < a.rows; ++i) {
+      T *row = c + i * ldc;
+      std::fill(row, row + b.cols, T(0));
+      for (std::size_t p = 0; p < a.cols; ++p) {
+        T x = a(i, p);
+        for (std::size_t j = 0; j < b.cols; ++j) {
+          row[j] += x * b(p, j);
+        }
+      }
+    }
+    return;
+  }
+  if constexpr (packed) {
+#if UTILS_X86_DISPATCH
+    switch (detect_simd_level()) {
+    case simd_level::avx512:
+      return gemm_avx512(a, b, c, ldc);
+    case simd_level::avx2:
+      if (has_avx2_fma()) {
+        return gemm_avx2(a, b, c, ldc);
+      }
+      break;
+    default:
+      break;
+    }
+#endif
+#if defined(__GNUC__)
+    gemm_kernel<T, 16, false>(a, b, c, ldc);
+#endif
+  }
+}
+
+template <typename T>
+T dot_vectors(const vector_operand<T> &a, const vector_operand<T> &b) {
+  check_conform(a.size, b.size, "dot");
+  if constexpr (SimdArithmetic<T>) {
+    if (a.stride == 1 && b.stride == 1) {
+      return dot_contiguous(a.data, b.data, a.size);
+    }
+  }
+  T acc = T(0);
+  for (std::size_t i = 0; i < a.size; ++i) {
+    acc += a[i] * b[i];
+  }
+  return acc;
+}
+
+template <typename T, typename C>
+tensor<T, 1> vector_matrix(const vector_operand<T> &x, const C &b,
+                           thread_pool *pool);
+
+// row i of the result is the dot product of row i of a with x, a
+// transposed tensor (unit stride columns) is walked as x . a^T instead
+template <typename T, typename C>
+tensor<T, 1> matrix_vector(const C &a, const vector_operand<T> &x,
+                           thread_pool *pool) {
+  if constexpr (Tensor<C> && std::same_as<array_element_t<C>, T>) {
+    tensor_view<const T, 2> view(a);
+    if (view.strides()[1] != 1 && view.strides()[0] == 1) {
+      return vector_matrix(x, view.transpose(), pool);
+    }
+  }
+  auto [rows, cols] = operand_shape(a);
+  check_conform(cols, x.size, "dot");
+  tensor<T, 1> result(rows);
+  T *out = result.data();
+  if constexpr (IndexableRows<C>) {
+    if (pool != nullptr && rows * cols > cache_chunk<T>) {
+      std::size_t chunk = std::max<std::size_t>(1, cache_chunk<T> / cols);
+      pool->parallel_for((rows + chunk - 1) / chunk, [&](std::size_t c) {
+        for (std::size_t i = c * chunk; i < std::min(rows, (c + 1) * chunk);
+             ++i) {
+          auto row = operand_row<T>(a, i);
+          check_conform(row.size, cols, "dot");
+          out[i] = dot_vectors(row, x);
+        }
+      });
+      return result;
     }
   }
+  for_each_row<T>(a, cols, [&](std::size_t i, const vector_operand<T> &row) {
+    out[i] = dot_vectors(row, x);
+  });
   return result;
 }
 
-template <Arithmetic T> auto range(T start, T end, T step = 1) {
-  std::vector<T> result;
-  for (T i = start; i < end; i += step) {
-    result.push_back(i);
+// the result accumulates x[i] * row i of b
+template <typename T, typename C>
+tensor<T, 1> vector_matrix(const vector_operand<T> &x, const C &b,
+                           thread_pool *pool) {
+  if constexpr (Tensor<C> && std::same_as<array_element_t<C>, T>) {
+    tensor_view<const T, 2> view(b);
+    if (view.strides()[1] != 1 && view.strides()[0] == 1) {
+      return matrix_vector(view.transpose(), x, pool);
+    }
   }
+  auto [rows, cols] = operand_shape(b);
+  check_conform(x.size, rows, "dot");
+  tensor<T, 1> result(cols);
+  T *out = result.data();
+  for_each_row<T>(b, cols, [&](std::size_t i, const vector_operand<T> &row) {
+    if constexpr (SimdArithmetic<T>) {
+      if (row.stride == 1) {
+        axpy_contiguous(x[i], row.data, out, cols);
+        return;
+      }
+    }
+    for (std::size_t j = 0; j < cols; ++j) {
+      out[j] += x[i] * row[j];
+    }
+  });
   return result;
 }
 
-template <ContainerWithArithmeticElement C>
-auto slice(C &&c, size_t start, size_t end, size_t step = 1) {
-  using ValueType = typename std::decay_t<decltype(*c.begin())>;
-  std::vector<ValueType> result;
-  for (size_t i = start; i < end && i < c.size(); i += step) {
-    result.push_back(c[i]);
+// blocks of rows of the result run in parallel, every task packs its own
+// panels of b
+template <typename T>
+tensor<T, 2> matrix_matrix(const matrix_ref<T> &a, const matrix_ref<T> &b,
+                           thread_pool *pool) {
+  check_conform(a.cols, b.rows, "dot");
+  tensor<T, 2> result(a.rows, b.cols);
+  T *c = result.data();
+  std::size_t work = a.rows * a.cols * b.cols;
+  if (pool == nullptr || pool->size() == 1 || work < (std::size_t(1) << 21)) {
+    gemm(a, b, c, b.cols);
+    return result;
   }
+  // a multiple of every micro-kernel height, at least 48 rows so that the
+  // packing of b stays small next to the product
+  std::size_t tasks = pool->size() * 4;
+  std::size_t rows = std::max<std::size_t>(48, (a.rows + tasks - 1) / tasks);
+  rows = (rows + 11) / 12 * 12;
+  pool->parallel_for((a.rows + rows - 1) / rows, [&](std::size_t i) {
+    std::size_t first = i * rows;
+    gemm(a.row_block(first, std::min(rows, a.rows - first)), b,
+         c + first * b.cols, b.cols);
+  });
   return result;
 }
 
-template <ContainerWithArithmeticElement C1, ContainerWithArithmeticElement C2>
-bool equals(C1 &&c1, C2 &&c2) {
-  if (c1.size() != c2.size())
-    return false;
-  for (auto &&[a, b] : zip(c1, c2)) {
-    if (a != b)
-      return false;
+template <typename T, typename A, typename B>
+auto dot_arrays(const A &a, const B &b, thread_pool *pool) {
+  constexpr std::size_t rank_a = array_depth<A>();
+  constexpr std::size_t rank_b = array_depth<B>();
+  if constexpr (rank_a == 1 && rank_b == 1) {
+    return dot_vectors(as_vector<T>(a), as_vector<T>(b));
+  } else if constexpr (rank_a == 2 && rank_b == 1) {
+    return array_result<A, B>(matrix_vector(a, as_vector<T>(b), pool));
+  } else if constexpr (rank_a == 1 && rank_b == 2) {
+    return array_result<A, B>(vector_matrix(as_vector<T>(a), b, pool));
+  } else {
+    auto ma = as_matrix<T>(a);
+    auto mb = as_matrix<T>(b);
+    return array_result<A, B>(matrix_matrix(ma.ref, mb.ref, pool));
+  }
+}
+
+template <typename F, typename T>
+concept TimesOf = std::same_as<std::decay_t<F>, std::multiplies<>> ||
+    std::same_as<std::decay_t<F>, std::multiplies<T>>;
+
+// g(...g(g(f(a0,b0),f(a1,b1)),f(a2,b2))...)
+template <typename R, typename T, typename F, typename G>
+R inner_vectors(F &f, G &g, const vector_operand<T> &a,
+                const vector_operand<T> &b) {
+  check_conform(a.size, b.size, "inner");
+  if (a.size == 0) {
+    throw std::runtime_error("inner: operands must not be empty");
+  }
+  R acc = f(a[0], b[0]);
+  for (std::size_t i = 1; i < a.size; ++i) {
+    acc = g(std::move(acc), f(a[i], b[i]));
+  }
+  return acc;
+}
+
+// out[j] = inner of x with column j of b, accumulated row by row of b
+template <typename T, typename F, typename G, typename Out>
+void inner_row(F &f, G &g, const vector_operand<T> &x, const matrix_ref<T> &b,
+               Out &out) {
+  check_conform(x.size, b.rows, "inner");
+  if (b.rows == 0) {
+    throw std::runtime_error("inner: operands must not be empty");
+  }
+  for (std::size_t j = 0; j < b.cols; ++j) {
+    out[j] = f(x[0], b(0, j));
+  }
+  for (std::size_t p = 1; p < b.rows; ++p) {
+    for (std::size_t j = 0; j < b.cols; ++j) {
+      out[j] = g(std::move(out[j]), f(x[p], b(p, j)));
+    }
   }
-  return true;
 }
 
-template <typename F, typename... Args> void timeit(F &&f, Args &&...args) {
-  constexpr int FIXED_RUNS = 10;
-  std::vector<std::chrono::microseconds> durations;
-  durations.reserve(FIXED_RUNS);
+template <typename T, typename F, typename G, typename A, typename B>
+auto inner_arrays(F &f, G &g, const A &a, const B &b) {
+  using R = std::decay_t<std::invoke_result_t<F &, const T &, const T &>>;
+  constexpr std::size_t rank_a = array_depth<A>();
+  constexpr std::size_t rank_b = array_depth<B>();
+  if constexpr (rank_a == 1 && rank_b == 1) {
+    return inner_vectors<R>(f, g, as_vector<T>(a), as_vector<T>(b));
+  } else {
+    using result_t =
+        std::conditional_t<rank_a + rank_b == 3, std::vector<R>,
+                           std::vector<std::vector<R>>>;
+    result_t result;
+    if constexpr (rank_a == 2 && rank_b == 1) {
+      auto y = as_vector<T>(b);
+      for_each_row<T>(a, operand_shape(a)[1],
+                      [&](std::size_t, const vector_operand<T> &row) {
+                        result.push_back(inner_vectors<R>(f, g, row, y));
+                      });
+    } else if constexpr (rank_a == 1 && rank_b == 2) {
+      auto mb = as_matrix<T>(b);
+      result.resize(mb.ref.cols);
+      inner_row(f, g, as_vector<T>(a), mb.ref, result);
+    } else {
+      auto ma = as_matrix<T>(a);
+      auto mb = as_matrix<T>(b);
+      check_conform(ma.ref.cols, mb.ref.rows, "inner");
+      result.resize(ma.ref.rows, std::vector<R>(mb.ref.cols));
+      for (std::size_t i = 0; i < ma.ref.rows; ++i) {
+        inner_row(f, g, ma.ref.row(i), mb.ref, result[i]);
+      }
+    }
+    if constexpr (Tensor<A> || Tensor<B>) {
+      return to_tensor(result);
+    } else {
+      return result;
+    }
+  }
+}
 
-  for (int i = 0; i < FIXED_RUNS; ++i) {
-    auto start = std::chrono::high_resolution_clock::now();
-    std::forward<F>(f)(std::forward<Args>(args)...);
-    auto end = std::chrono::high_resolution_clock::now();
-    auto duration =
-        std::chrono::duration_cast<std::chrono::microseconds>(end - start);
-    durations.emplace_back(duration);
-    std::cout << "[Run " << (i + 1) << "] " << duration.count() << " μs\n";
+// out[j] = f(x, y[j]), restrict so that simple f vectorize
+template <typename F, typename X, typename Y, typename R>
+void outer_row(F &f, const X &x, const vector_operand<Y> &y,
+               R *__restrict out) {
+  if (y.stride == 1) {
+    const Y *__restrict in = y.data;
+    for (std::size_t j = 0; j < y.size; ++j) {
+      out[j] = f(x, in[j]);
+    }
+  } else {
+    for (std::size_t j = 0; j < y.size; ++j) {
+      out[j] = f(x, y[j]);
+    }
   }
+}
+} // namespace detail
+
+/*
+dot({a1,a2,...},{b1,b2,...}) = a1 b1 + a2 b2 + ...
+dot(m,v), dot(v,m), dot(m1,m2) are the matrix-vector, vector-matrix and
+matrix products
+reference to : https://reference.wolfram.com/language/ref/Dot.html
+vectors are containers of arithmetic values or rank 1 tensors, matrices are
+nested containers or rank 2 tensors with any strides (m.transpose() is not
+copied). the elements are converted to their common type. a vector or
+matrix result is a tensor if either operand is one, a std::vector
+(of std::vector) otherwise. shapes that do not conform throw.
+matrix products of SIMD types run a packed, cache blocked kernel with a
+register tile of C and fused multiply-adds, so floating point results may
+differ in the last bits from a naive loop. dot(utils::par,...) splits matrix
+products into blocks of rows and matrix-vector products into row chunks.
+*/
+template <detail::ArrayOperand A, detail::ArrayOperand B>
+auto dot(const A &a, const B &b) {
+  UTILS_PROBE(dot, a);
+  using T = std::common_type_t<detail::array_element_t<A>,
+                               detail::array_element_t<B>>;
+  return detail::dot_arrays<T>(a, b, nullptr);
+}
 
-  long long total = 0;
-  for (const auto &d : durations)
-    total += d.count();
-  double average = static_cast<double>(total) / FIXED_RUNS;
-  std::cout << "\nAverage time: " << average << " μs\n";
+template <ExecutionPolicy P, detail::ArrayOperand A, detail::ArrayOperand B>
+auto dot(P &&policy, const A &a, const B &b) {
+  UTILS_PROBE(dot, a);
+  using T = std::common_type_t<detail::array_element_t<A>,
+                               detail::array_element_t<B>>;
+  return detail::dot_arrays<T>(a, b, &detail::pool_of(policy));
 }
 
 /*
-fold(f,x1,x2,x3,x4,x5...)=f(...f(f(f(f(x1,x2),x3),x4),x5)...)
-reference to : https://reference.wolfram.com/language/ref/Fold.html
+inner(f,g,{a1,a2,a3},{b1,b2,b3}) = g(g(f(a1,b1),f(a2,b2)),f(a3,b3))
+reference to : https://reference.wolfram.com/language/ref/Inner.html
+Mathematica's Inner[f,a,b,g] with g moved to the front. the operands are
+those of dot, for matrices element (i,j) of the result is the inner of row i
+of a and column j of b. inner(std::multiplies<>{},std::plus<>{},a,b) is dot
+and runs its kernels, other f/g are applied in a loop, e.g. the min-plus
+(shortest path) product inner(std::plus<>{},min_of,d,d). empty operands
+throw as g has no identity.
 */
-template <typename Func, typename First, typename Second>
-auto fold(Func &&f, First &&first, Second &&second) {
-  return std::forward<Func>(f)(std::forward<First>(first),
-                               std::forward<Second>(second));
+template <typename F, typename G, detail::ArrayOperand A,
+          detail::ArrayOperand B>
+auto inner(F &&f, G &&g, const A &a, const B &b) {
+  using T = std::common_type_t<detail::array_element_t<A>,
+                               detail::array_element_t<B>>;
+  if constexpr (detail::TimesOf<F, T> && detail::PlusOf<G, T> &&
+                std::same_as<std::decay_t<std::invoke_result_t<
+                                 F &, const T &, const T &>>,
+                             T>) {
+    return dot(a, b);
+  } else {
+    return detail::inner_arrays<T>(f, g, a, b);
+  }
 }
 
-template <typename Func, typename First, typename Second, typename... Rest>
-auto fold(Func &&f, First &&first, Second &&second, Rest &&...rest) {
-  return fold(
-      std::forward<Func>(f),
-      // fold(std::forward<Func>(f),std::forward<First>(first),std::forward<Second>(second)),
-      // // both ok
-      std::forward<Func>(f)(std::forward<First>(first),
-                            std::forward<Second>(second)),
-      std::forward<Rest>(rest)...);
-}
-
-template <template <typename, typename> class Container, typename T,
-          typename Allocator = std::allocator<T>, typename Func>
-auto fold(Func &&f, const Container<T, Allocator> &container) {
-  if (container.size() == 0) {
-    throw std::runtime_error(
-        std::string("container must contain at least one element!"));
+/*
+outer(f,{a1,a2},{b1,b2,b3}) = {{f(a1,b1),f(a1,b2),f(a1,b3)},
+                               {f(a2,b1),f(a2,b2),f(a2,b3)}}
+reference to : https://reference.wolfram.com/language/ref/Outer.html
+for two vectors (containers of arithmetic values or rank 1 tensors), the
+result is a tensor<R,2> if either is a tensor, a vector<vector<R>> otherwise.
+*/
+template <typename F, detail::VectorOperand A, detail::VectorOperand B>
+auto outer(F &&f, const A &a, const B &b) {
+  using TA = detail::array_element_t<A>;
+  using TB = detail::array_element_t<B>;
+  using R = std::decay_t<std::invoke_result_t<F &, const TA &, const TB &>>;
+  auto x = detail::as_vector<TA>(a);
+  auto y = detail::as_vector<TB>(b);
+  if constexpr (Tensor<A> || Tensor<B>) {
+    tensor<R, 2> result(x.size, y.size);
+    for (std::size_t i = 0; i < x.size; ++i) {
+      detail::outer_row(f, x[i], y, result.data() + i * y.size);
+    }
+    return result;
+  } else {
+    std::vector<std::vector<R>> result(x.size, std::vector<R>(y.size));
+    for (std::size_t i = 0; i < x.size; ++i) {
+      if constexpr (std::is_same_v<R, bool>) {
+        for (std::size_t j = 0; j < y.size; ++j) {
+          result[i][j] = f(x[i], y[j]);
+        }
+      } else {
+        detail::outer_row(f, x[i], y, result[i].data());
+      }
+    }
+    return result;
   }
-  return std::accumulate(
-      container.begin(), container.end(), *container.begin(),
-      [&f](auto a, auto b) { return std::forward<Func>(f)(a, b); });
 }
 
 /*
 nest(f,x0,n) = f(...f(f(f(f(x0))))...) // n nest time
 reference to : https://reference.wolfram.com/language/ref/Nest.html
+f is applied exactly n times (nest(f,x0,0) = x0) in a loop, so any depth runs
+in constant stack space. f is only ever called as an lvalue, move-only
+callables are fine.
+*/
+template <typename Func, typename Start>
+requires std::invocable<Func &, Start>
+constexpr auto nest(Func &&f, Start &&start, size_t depth) {
+  using T = std::decay_t<std::invoke_result_t<Func &, Start>>;
+  T value(std::forward<Start>(start));
+  for (size_t i = 0; i < depth; ++i) {
+    value = f(std::move(value));
+  }
+  return value;
+}
+
+/*
+nest_list(f,x0,n) = {x0, f(x0), f(f(x0)), ...} // n+1 elements
+reference to : https://reference.wolfram.com/language/ref/NestList.html
 */
 template <typename Func, typename Start>
-auto nest(Func &&f, Start &&start, size_t depth) {
-  if (depth == 0) {
-    return std::forward<Func>(f)(std::forward<Start>(start));
+requires std::invocable<Func &, Start>
+constexpr auto nest_list(Func &&f, Start &&start, size_t depth) {
+  using T = std::decay_t<std::invoke_result_t<Func &, Start>>;
+  std::vector<T> result;
+  result.reserve(depth + 1);
+  result.emplace_back(std::forward<Start>(start));
+  for (size_t i = 0; i < depth; ++i) {
+    result.push_back(f(result.back()));
+  }
+  return result;
+}
+
+/*
+nest_while(f,x0,test) applies f while test holds for the current value, at
+most max_iterations times. test may also take the previous and the current
+value, e.g. to stop once an iteration has converged:
+  nest_while(newton, 1.0, [](double a, double b) { return a != b; })
+reference to : https://reference.wolfram.com/language/ref/NestWhile.html
+*/
+template <typename Func, typename Start, typename Test>
+requires std::invocable<Func &, Start>
+constexpr auto nest_while(Func &&f, Start &&start, Test &&test,
+                          size_t max_iterations =
+                              std::numeric_limits<size_t>::max()) {
+  using T = std::decay_t<std::invoke_result_t<Func &, Start>>;
+  T value(std::forward<Start>(start));
+  if constexpr (std::predicate<Test &, const T &, const T &>) {
+    for (size_t i = 0; i < max_iterations; ++i) {
+      T next = f(value);
+      bool keep_going = test(std::as_const(value), std::as_const(next));
+      value = std::move(next);
+      if (!keep_going) {
+        break;
+      }
+    }
+  } else {
+    static_assert(std::predicate<Test &, const T &>,
+                  "nest_while: test must take one or two values");
+    for (size_t i = 0; i < max_iterations && test(std::as_const(value));
+         ++i) {
+      value = f(std::move(value));
+    }
+  }
+  return value;
+}
+
+/*
+fixed_point(f,x0) applies f until same_test(previous, current) holds (by
+default until the value stops changing) or max_iterations is reached.
+reference to : https://reference.wolfram.com/language/ref/FixedPoint.html
+*/
+template <typename Func, typename Start, typename SameTest = std::equal_to<>>
+requires std::invocable<Func &, Start>
+constexpr auto fixed_point(Func &&f, Start &&start,
+                           size_t max_iterations =
+                               std::numeric_limits<size_t>::max(),
+                           SameTest same_test = SameTest()) {
+  return nest_while(
+      f, std::forward<Start>(start),
+      [&same_test](const auto &previous, const auto &current) {
+        return !same_test(previous, current);
+      },
+      max_iterations);
+}
+
+struct memoize_options {
+  // results kept before the least recently used ones are evicted, 0 for no
+  // limit
+  std::size_t capacity = 1 << 16;
+  // independently locked parts of the table, 0 for 4 per hardware thread
+  std::size_t shards = 0;
+};
+
+struct memoize_stats {
+  std::uint64_t hits = 0;
+  std::uint64_t misses = 0;
+  std::uint64_t evictions = 0;
+  std::size_t size = 0;
+
+  double hit_rate() const {
+    std::uint64_t calls = hits + misses;
+    return calls == 0 ? 0.0 : static_cast<double>(hits) / calls;
+  }
+};
+
+namespace detail {
+// splitmix64 finalizer, std::hash of integers is the identity and the shard
+// is picked by the top bits
+constexpr std::uint64_t mix_hash(std::uint64_t h) {
+  h ^= h >> 30;
+  h *= 0xbf58476d1ce4e5b9ULL;
+  h ^= h >> 27;
+  h *= 0x94d049bb133111ebULL;
+  return h ^ (h >> 31);
+}
+
+template <typename Key> struct tuple_hash {
+  std::size_t operator()(const Key &key) const {
+    return std::apply(
+        [](const auto &...args) {
+          std::uint64_t h = 0;
+          ((h = mix_hash(h + std::hash<std::decay_t<decltype(args)>>{}(args))),
+           ...);
+          return static_cast<std::size_t>(h);
+        },
+        key);
+  }
+};
+
+// the decayed parameter types of a callable that is not overloaded
+template <typename F> struct call_arguments;
+template <typename R, typename... A> struct call_arguments<R (*)(A...)> {
+  using type = std::tuple<std::decay_t<A>...>;
+};
+template <typename R, typename... A>
+struct call_arguments<R (*)(A...) noexcept> : call_arguments<R (*)(A...)> {};
+template <typename C, typename R, typename... A>
+struct call_arguments<R (C::*)(A...)> : call_arguments<R (*)(A...)> {};
+template <typename C, typename R, typename... A>
+struct call_arguments<R (C::*)(A...) const> : call_arguments<R (*)(A...)> {};
+template <typename C, typename R, typename... A>
+struct call_arguments<R (C::*)(A...) noexcept> : call_arguments<R (*)(A...)> {
+};
+template <typename C, typename R, typename... A>
+struct call_arguments<R (C::*)(A...) const noexcept>
+    : call_arguments<R (*)(A...)> {};
+
+template <typename F>
+concept DeducibleArguments = std::is_pointer_v<F> || requires {
+  &F::operator();
+};
+
+template <typename F> auto deduce_arguments() {
+  if constexpr (std::is_pointer_v<F>) {
+    return typename call_arguments<F>::type{};
+  } else {
+    return typename call_arguments<decltype(&F::operator())>::type{};
+  }
+}
+
+// one lock, one hash table and one LRU list (most recent at the front,
+// linked through the table's nodes, which never move)
+template <typename Key, typename R> class lru_shard {
+public:
+  std::optional<R> find(const Key &key) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    auto it = _table.find(key);
+    if (it == _table.end()) {
+      ++_misses;
+      return std::nullopt;
+    }
+    ++_hits;
+    unlink(&*it);
+    push_front(&*it);
+    return it->second.value;
+  }
+
+  // another thread may have inserted the key meanwhile, the first value stays
+  void insert(Key &&key, const R &value, std::size_t capacity) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    auto [it, inserted] = _table.try_emplace(std::move(key), entry{value});
+    if (!inserted) {
+      return;
+    }
+    push_front(&*it);
+    if (capacity != 0 && _table.size() > capacity) {
+      node *last = _tail;
+      unlink(last);
+      _table.erase(last->first);
+      ++_evictions;
+    }
+  }
+
+  void add_stats(memoize_stats &stats) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    stats.hits += _hits;
+    stats.misses += _misses;
+    stats.evictions += _evictions;
+    stats.size += _table.size();
+  }
+
+  void clear() {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _table.clear();
+    _head = _tail = nullptr;
+    _hits = _misses = _evictions = 0;
+  }
+
+private:
+  struct entry;
+  using node = std::pair<const Key, entry>;
+  struct entry {
+    R value;
+    node *prev = nullptr;
+    node *next = nullptr;
+  };
+
+  void unlink(node *n) {
+    entry &e = n->second;
+    (e.prev ? e.prev->second.next : _head) = e.next;
+    (e.next ? e.next->second.prev : _tail) = e.prev;
+  }
+  void push_front(node *n) {
+    n->second.prev = nullptr;
+    n->second.next = _head;
+    (_head ? _head->second.prev : _tail) = n;
+    _head = n;
+  }
+
+  std::mutex _mutex;
+  std::unordered_map<Key, entry, tuple_hash<Key>> _table;
+  node *_head = nullptr;
+  node *_tail = nullptr;
+  std::uint64_t _hits = 0;
+  std::uint64_t _misses = 0;
+  std::uint64_t _evictions = 0;
+};
+} // namespace detail
+
+/*
+memoized<F, Args...> is the callable returned by memoize, copies share one
+cache. the result of f(args...) is kept under the decayed arguments (hashed
+with std::hash, compared with ==) in a table split into shards by the top
+bits of the hash, each with its own mutex and LRU list, so parallel callers
+rarely wait for each other. f runs outside the lock: concurrent misses on
+the same arguments may both call f and the first result is kept, which is
+harmless for the pure functions memoize is meant for. exceptions from f are
+passed on and nothing is cached.
+*/
+template <typename F, typename... Args> class memoized {
+public:
+  using key_type = std::tuple<Args...>;
+  using result_type = std::decay_t<std::invoke_result_t<F &, const Args &...>>;
+  static_assert(!std::is_void_v<result_type>,
+                "memoize: f must return a value");
+
+  memoized(F f, const memoize_options &options)
+      : _state(std::make_shared<state>(std::move(f), options)) {}
+
+  result_type operator()(const Args &...args) const {
+    key_type key(args...);
+    auto &shard = _state->shard_of(detail::tuple_hash<key_type>{}(key));
+    if (auto cached = shard.find(key)) {
+      return std::move(*cached);
+    }
+    result_type value = _state->f(args...);
+    shard.insert(std::move(key), value, _state->shard_capacity);
+    return value;
+  }
+
+  memoize_stats stats() const {
+    memoize_stats result;
+    for (auto &shard : _state->shards) {
+      shard.add_stats(result);
+    }
+    return result;
+  }
+
+  // drops every cached result and resets the statistics
+  void clear() const {
+    for (auto &shard : _state->shards) {
+      shard.clear();
+    }
+  }
+
+private:
+  struct state {
+    state(F func, const memoize_options &options) : f(std::move(func)) {
+      std::size_t n = options.shards != 0
+                          ? options.shards
+                          : 4 * std::max(1u, std::thread::hardware_concurrency());
+      // never more shards than entries, then capacity / shards >= 1 and the
+      // shards together hold at most capacity results
+      if (options.capacity != 0) {
+        n = std::min(n, options.capacity);
+      }
+      n = std::bit_floor(std::max<std::size_t>(n, 1));
+      shard_bits = static_cast<unsigned>(std::countr_zero(n));
+      shard_capacity = options.capacity / n;
+      shards = std::vector<detail::lru_shard<key_type, result_type>>(n);
+    }
+
+    detail::lru_shard<key_type, result_type> &shard_of(std::size_t hash) {
+      return shards[shard_bits == 0
+                        ? 0
+                        : static_cast<std::uint64_t>(hash) >>
+                              (64 - shard_bits)];
+    }
+
+    F f;
+    std::vector<detail::lru_shard<key_type, result_type>> shards;
+    unsigned shard_bits = 0;
+    std::size_t shard_capacity = 0;
+  };
+
+  std::shared_ptr<state> _state;
+};
+
+/*
+memoize(f) caches the results of an expensive pure function, e.g. for
+callbacks of map or nest that see the same inputs again and again:
+  auto score = utils::memoize([](int id) { return expensive_score(id); });
+  auto scores = utils::map(utils::par, score, ids);
+  score.stats().hit_rate();
+the argument types are deduced from f, generic lambdas and overloaded
+callables name them: utils::memoize<int, std::string>(f). at most
+options.capacity results are kept, the least recently used are evicted
+first. a lookup costs one hash, one uncontended lock and one table probe,
+so it only pays off for f well above ~100ns.
+*/
+template <typename... Args, typename F>
+auto memoize(F &&f, const memoize_options &options = {}) {
+  using Func = std::decay_t<F>;
+  if constexpr (sizeof...(Args) > 0) {
+    return memoized<Func, std::decay_t<Args>...>(std::forward<F>(f), options);
   } else {
-    return nest(std::forward<Func>(f),
-                std::forward<Func>(f)(std::forward<Start>(start)), depth - 1);
+    static_assert(detail::DeducibleArguments<Func>,
+                  "memoize: name the argument types of a generic or "
+                  "overloaded callable, e.g. memoize<int>(f)");
+    using Key = decltype(detail::deduce_arguments<Func>());
+    return [&]<typename... A>(std::tuple<A...> *) {
+      return memoized<Func, A...>(std::forward<F>(f), options);
+    }(static_cast<Key *>(nullptr));
   }
 }
 
+/*
+the reductions most callers need, sum/prod/max/min of a vector of
+int/int64_t/float/double, are instantiated once in utils.cpp together with
+the SIMD kernels behind them. a target linking the utils library is compiled
+with UTILS_PRECOMPILED and only declares them here, so its translation units
+skip instantiating and optimizing those kernels. the public functions are
+constexpr and still inlined where called; they are left out of an
+instrumented build, whose UTILS_PROBE bodies differ from the library's.
+*/
+#if defined(UTILS_PRECOMPILED) || defined(UTILS_INSTANTIATE)
+#ifdef UTILS_INSTANTIATE
+#define UTILS_TEMPLATE template
+#else
+#define UTILS_TEMPLATE extern template
+#endif
+#define UTILS_COMMON_KERNELS(T)                                                \
+  UTILS_TEMPLATE T detail::reduce_contiguous<detail::reduce_op::sum, T>(       \
+      const T *, std::size_t);                                                 \
+  UTILS_TEMPLATE T detail::reduce_contiguous<detail::reduce_op::prod, T>(      \
+      const T *, std::size_t);                                                 \
+  UTILS_TEMPLATE detail::minmax_result<T> detail::minmax_contiguous<T>(        \
+      const T *, std::size_t);
+#if UTILS_INSTRUMENT
+#define UTILS_COMMON_REDUCTIONS(T)
+#else
+#define UTILS_COMMON_REDUCTIONS(T)                                             \
+  UTILS_TEMPLATE T sum<std::vector<T> &>(std::vector<T> &);                    \
+  UTILS_TEMPLATE T sum<const std::vector<T> &>(const std::vector<T> &);        \
+  UTILS_TEMPLATE T prod<std::vector<T> &>(std::vector<T> &);                   \
+  UTILS_TEMPLATE T prod<const std::vector<T> &>(const std::vector<T> &);       \
+  UTILS_TEMPLATE auto max<std::vector<T>>(const std::vector<T> &);             \
+  UTILS_TEMPLATE auto min<std::vector<T>>(const std::vector<T> &);
+#endif
+UTILS_COMMON_KERNELS(int)
+UTILS_COMMON_KERNELS(std::int64_t)
+UTILS_COMMON_KERNELS(float)
+UTILS_COMMON_KERNELS(double)
+UTILS_COMMON_REDUCTIONS(int)
+UTILS_COMMON_REDUCTIONS(std::int64_t)
+UTILS_COMMON_REDUCTIONS(float)
+UTILS_COMMON_REDUCTIONS(double)
+#undef UTILS_COMMON_REDUCTIONS
+#undef UTILS_COMMON_KERNELS
+#undef UTILS_TEMPLATE
+#endif
+
 } // end namespace utils
 
 #endif